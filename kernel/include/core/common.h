@@ -49,10 +49,22 @@ void outb(uint16_t port, uint8_t val);
 uint8_t inb(uint16_t port);
 // Reads a 16-bit value from I/O `port` via the x86 `inw` instruction.
 uint16_t inw(uint16_t port);
+// Writes a 16-bit value to I/O `port` via the x86 `outw` instruction.
+void outw(uint16_t port, uint16_t val);
+// Reads the 64-bit time-stamp counter via the x86 `rdtsc` instruction.
+uint64_t rdtsc(void);
 // Clears the interrupt flag in EFLAGS (disables maskable interrupts).
 void cli();
 // Sets the interrupt flag in EFLAGS (enables maskable interrupts).
 void sti();
+// Interrupt flag bit of EFLAGS
+#define EFLAGS_IF (1u << 9)
+// Disables interrupts and returns the previous EFLAGS, for irq_restore.
+uint32_t irq_save(void);
+// Re-enables interrupts if they were enabled in `flags` (from irq_save).
+void irq_restore(uint32_t flags);
+// Returns whether maskable interrupts are enabled.
+bool irqs_enabled(void);
 // Reads a model-specific register. `msr` is the index; returns value via `lo`/`hi`
 // pointers (kernel virtual addresses) representing the 64-bit MSR split in two.
 void get_msr(uint32_t msr, uint32_t* lo, uint32_t* hi);
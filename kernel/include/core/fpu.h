@@ -0,0 +1,55 @@
+#ifndef _KERNEL_FPU_H
+#define _KERNEL_FPU_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// x87/SSE state management.
+//
+// The FPU is switched lazily: the registers keep the state of `fpu_owner`
+// across context switches, and CR0.TS is set whenever any other task runs.
+// The first FPU/SSE instruction of that task raises #NM (vector 7), whose
+// handler saves the owner's state with FXSAVE, restores (or initializes) the
+// current task's and hands ownership over. Tasks that never touch the FPU
+// never pay for a save or restore, nor for the save area itself, which is
+// only allocated on first use.
+
+// Size of the FXSAVE/FXRSTOR area; it must be 16-byte aligned
+#define FPU_STATE_SIZE (512)
+// MXCSR after reset: all SIMD exceptions masked, round to nearest
+#define FPU_MXCSR_DEFAULT (0x1F80)
+
+#define CR0_MP (1 << 1)
+#define CR0_EM (1 << 2)
+#define CR0_TS (1 << 3)
+#define CR0_NE (1 << 5)
+#define CR4_OSFXSR (1 << 9)
+#define CR4_OSXMMEXCPT (1 << 10)
+
+struct fpu_state {
+    uint8_t fxsave[FPU_STATE_SIZE];
+} __attribute__((aligned(16)));
+
+typedef struct fpu_state fpu_state_t;
+
+struct proc;
+
+// Enables the x87 FPU and SSE on the calling CPU (CR0.EM off, MP/NE on,
+// CR4.OSFXSR/OSXMMEXCPT) and sets CR0.TS so the first use traps. Panics if
+// the CPU lacks FXSAVE/FXRSTOR or SSE. Run by every CPU as it comes up.
+void fpu_init_cpu(void);
+// Sets up the boot CPU with fpu_init_cpu and installs the #NM handler.
+void fpu_init(void);
+// Called on every context switch, after `current_proc` is updated: clears
+// CR0.TS if `next` owns the FPU registers and sets it otherwise.
+void fpu_switch(struct proc* next);
+// Drops `p`'s FPU state: forgets it as the owner and frees its save area.
+// Called when the process is torn down.
+void fpu_release(struct proc* p);
+// Lets kernel code use the FPU/SSE registers: saves the owner's state and
+// clears CR0.TS. Interrupts must stay disabled until kernel_fpu_end.
+void kernel_fpu_begin(void);
+// Ends a kernel_fpu_begin section; the next FPU user traps and reloads.
+void kernel_fpu_end(void);
+
+#endif
@@ -21,13 +21,29 @@ struct gdt_ptr {
 
 typedef struct gdt_ptr gdt_ptr_t;
 
-// Builds a flat-segmentation GDT (kernel/user code/data descriptors) in memory
-// and loads it via `gdt_flush`. Must be called before enabling interrupts.
+// Every CPU has its own GDT (in its per-CPU area, core/smp.h) with the same
+// layout; only the TSS and per-CPU descriptors differ between CPUs.
+#define GDT_ENTRIES (7)
+// Task state segment of the CPU (index 5)
+#define GDT_TSS_SEL (0x28)
+// Data segment covering the CPU's cpu_t (index 6), loaded into %gs whenever
+// the CPU runs kernel code
+#define GDT_PERCPU_SEL (0x30)
+
+struct cpu;
+
+// Builds the boot processor's GDT and TSS (per-CPU area 0) and loads them.
+// Must be called before enabling interrupts.
 void gdt_init();
-// Populates a GDT entry at `index` with base, limit, access, and granularity
-// fields. All parameters are raw descriptor fields (not pointers or addresses
-// to data structures). Writes into the in-memory GDT (kernel virtual address).
-void gdt_set_gate(int32_t, uint32_t, uint32_t, uint8_t, uint8_t);
+// Builds a flat-segmentation GDT (kernel/user code/data descriptors, TSS and
+// per-CPU segment) in the per-CPU area `cpu`, loads it via `gdt_flush`, points
+// %gs at the area and loads the CPU's TSS. Runs on the CPU being set up.
+void gdt_init_cpu(struct cpu* cpu);
+// Populates entry `index` of `gdt` with base, limit, access, and granularity
+// fields. All other parameters are raw descriptor fields (not pointers or
+// addresses to data structures).
+void gdt_set_gate(gdt_entry_t* gdt, int32_t index, uint32_t base, uint32_t limit, uint8_t access,
+    uint8_t flags);
 // Reloads GDTR with the provided pointer (kernel virtual address to a `gdt_ptr_t`),
 // and updates segment registers. Implemented in assembly and does not return
 // until the new GDT is active.
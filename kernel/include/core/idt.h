@@ -26,6 +26,8 @@ void irq_remap();
 // Initializes the IDT in memory, installs gates for exceptions/IRQs using
 // ISRs/IRQs stubs, remaps PIC, and loads IDTR via `idt_flush`.
 void idt_init();
+// Loads the IDT built by idt_init on the calling CPU (application processors).
+void idt_load(void);
 // Sets a single IDT entry: `index` is the vector, `base` is the handler’s linear
 // (kernel virtual) address, `selector` is the code segment selector, and `flags`
 // encode type, DPL, and present bit. Writes into the in-memory IDT.
@@ -0,0 +1,42 @@
+#ifndef _KERNEL_RBTREE_H
+#define _KERNEL_RBTREE_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Intrusive red-black tree. Nodes are embedded in the objects they order, so
+// the tree never allocates; `rb_entry` recovers the containing object. The
+// ordering is supplied per insert as a strict less-than on nodes; equal keys
+// are kept in insertion order.
+
+struct rb_node {
+    struct rb_node* parent;
+    struct rb_node* left;
+    struct rb_node* right;
+    bool red;
+};
+
+typedef struct rb_node rb_node_t;
+
+struct rb_root {
+    rb_node_t* node;
+};
+
+typedef struct rb_root rb_root_t;
+
+typedef bool (*rb_less_t)(const rb_node_t* a, const rb_node_t* b);
+
+// Pointer to the object of type `type` whose member `member` is node `ptr`
+#define rb_entry(ptr, type, member) ((type*)((uint8_t*)(ptr) - offsetof(type, member)))
+
+// Inserts `node` into `root`, placing it after any nodes that compare equal.
+void rb_insert(rb_root_t* root, rb_node_t* node, rb_less_t less);
+// Removes `node`, which must currently be in `root`.
+void rb_erase(rb_root_t* root, rb_node_t* node);
+// Returns the smallest node, or NULL if the tree is empty. O(log n).
+rb_node_t* rb_first(const rb_root_t* root);
+// Returns the in-order successor of `node`, or NULL if it is the largest.
+rb_node_t* rb_next(const rb_node_t* node);
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef _KERNEL_SMP_H
+#define _KERNEL_SMP_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <core/gdt.h>
+#include <core/tss.h>
+
+// Multiprocessor bring-up. The boot processor (BSP) starts every other
+// processor listed in the MADT with the INIT-SIPI-SIPI sequence. Each
+// application processor (AP) begins in real mode in a trampoline copied
+// below 1 MiB (smp_trampoline.S), switches to protected mode with paging
+// through a temporary page directory that also identity maps the
+// trampoline, and lands in the kernel on a stack of its own. There it
+// loads its own GDT and TSS, the shared IDT and the kernel page directory,
+// enables its FPU/SSE, then idles.
+//
+// Every CPU has a per-CPU area (cpu_t) holding its GDT and TSS. In kernel
+// mode %gs is a data segment covering exactly that area (GDT_PERCPU_SEL):
+// gdt_init_cpu loads it, and the interrupt stubs reload it on every entry
+// and restore the interrupted value on exit. this_cpu() reads the area's
+// self pointer at %gs:0.
+//
+// The scheduler, timers and interrupts still run on the BSP alone.
+// APs keep interrupts disabled in their idle loop until the kernel's
+// shared state is protected by locks.
+
+// Most processors brought up; further MADT entries are ignored
+#define SMP_MAX_CPUS (8)
+// Physical page the AP trampoline is copied to while APs start. The page is
+// saved and restored around bring-up. Must match smp_trampoline.S.
+#define SMP_TRAMPOLINE_ADDR (0x8000)
+// Kernel stack of each AP
+#define SMP_AP_STACK_PAGES (2)
+// How long the BSP waits for an AP to report in after its last SIPI; an AP
+// that misses it is sent INIT again and left in wait-for-SIPI
+#define SMP_AP_TIMEOUT_US (100000)
+
+struct cpu {
+    // Address of this structure; read through %gs:0 by this_cpu
+    struct cpu* self;
+    // Index in the per-CPU area array; 0 is the BSP
+    uint32_t id;
+    uint32_t apic_id;
+    // Set by the CPU itself once it runs the kernel
+    volatile bool online;
+    // Top of the CPU's boot stack, also its idle stack (0 on the BSP, which
+    // boots on the bootstrap stack)
+    uint32_t kstack_top;
+    gdt_entry_t gdt[GDT_ENTRIES];
+    gdt_ptr_t gdt_ptr;
+    tss_entry_t tss;
+};
+
+typedef struct cpu cpu_t;
+
+// Returns per-CPU area `id` (0 is the BSP's). `id` must be below
+// SMP_MAX_CPUS.
+cpu_t* smp_cpu(uint32_t id);
+// Returns the per-CPU area of the calling CPU. Needs gdt_init_cpu to have run
+// on it.
+cpu_t* this_cpu(void);
+// Returns the number of CPUs online, the BSP included.
+uint32_t smp_num_online(void);
+// Starts every AP listed in the MADT (parse_madt must have run) and waits for
+// each to come online. Needs the kernel heap, the PMM and tsc_init. Must be
+// called with interrupts disabled, before any user process runs.
+void smp_init(void);
+
+// AP trampoline image (smp_trampoline.S): real-mode code copied to
+// SMP_TRAMPOLINE_ADDR, followed by the parameters the BSP fills in for each
+// AP it starts
+extern uint8_t smp_trampoline_start[];
+extern uint8_t smp_trampoline_end[];
+extern uint32_t smp_trampoline_cr3;
+extern uint32_t smp_trampoline_stack;
+extern uint32_t smp_trampoline_entry;
+
+#endif
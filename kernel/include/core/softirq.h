@@ -0,0 +1,57 @@
+#ifndef _KERNEL_SOFTIRQ_H
+#define _KERNEL_SOFTIRQ_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Softirqs: deferred halves of interrupt handlers. A hard IRQ handler does the
+// minimum (acknowledge the device, grab its data), marks a softirq vector
+// pending and returns; irq_handler runs the pending vectors after EOI, with
+// interrupts enabled, before it considers a reschedule. Work that may sleep
+// belongs on a workqueue (proc/workqueue.h) instead.
+//
+// Softirq handlers run on the kernel stack of whichever task was interrupted
+// and must not block. They are not preemptible and do not nest: an interrupt
+// arriving while they run only marks more vectors pending, which the running
+// pass picks up. A pass is skipped if the interrupted code had preemption
+// disabled (it may be halfway through the kernel heap); preempt_enable runs
+// it instead.
+
+// Vectors, run in this order within a pass
+enum softirq_nr {
+    SOFTIRQ_TIMER,      // expired kernel timers (core/timer.h)
+    SOFTIRQ_NR,
+};
+
+// Passes over the pending bitmap made by one do_softirq call; vectors raised
+// again after that wait for the next IRQ exit
+#define SOFTIRQ_MAX_RESTART (10)
+
+typedef void (*softirq_handler_t)(void);
+
+struct softirq_stats {
+    // Handler invocations
+    uint64_t runs;
+    // Time spent in the handler, in microseconds
+    uint64_t total_us;
+    uint64_t max_us;
+};
+
+typedef struct softirq_stats softirq_stats_t;
+
+// Installs `handler` for vector `nr`. Returns 0, or -1 if `nr` is out of range
+// or already has a handler.
+int softirq_register(uint32_t nr, softirq_handler_t handler);
+// Marks vector `nr` pending. Safe from any context.
+void raise_softirq(uint32_t nr);
+// Returns whether any vector is pending.
+bool softirq_pending(void);
+// Runs the handlers of all pending vectors, repeating while more are raised
+// (at most SOFTIRQ_MAX_RESTART passes). Must be called with interrupts
+// disabled, which it enables around the handlers; does nothing when called
+// from a softirq or with preemption disabled.
+void do_softirq(void);
+// Prints the invocation count and run time of every vector.
+void softirq_print_stats(void);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef _KERNEL_SPINLOCK_H
+#define _KERNEL_SPINLOCK_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ticket spinlocks. A locker atomically takes the next ticket and spins until
+// the lock serves it, so waiters get the lock in arrival order and a CPU
+// cannot be starved by others that keep re-taking it.
+//
+// Holding a spinlock disables preemption (proc/scheduler.h), so the holder
+// must not block; use a mutex (proc/mutex.h) around code that may sleep. Data
+// also touched by interrupt handlers needs the irqsave variants, which disable
+// interrupts on the local CPU before locking. While only the BSP runs kernel
+// code (core/smp.h) a lock is never found held, except by an interrupt
+// handler taking a lock that the interrupted code holds without irqsave,
+// which deadlocks.
+//
+// Every lock keeps contention statistics unless the kernel is built with
+// LOCK_STATS=0. Locks initialized with a name are registered and printed by
+// lock_print_stats; registration is permanent, so locks embedded in objects
+// that are freed again should stay anonymous (name NULL).
+
+#ifndef LOCK_STATS
+#define LOCK_STATS 1
+#endif
+
+struct lock_stats {
+    const char* name;
+    // Acquisitions, and those that found the lock held and had to wait
+    uint64_t acquisitions;
+    uint64_t contended;
+    // TSC cycles spent waiting by contended acquisitions, in total and the
+    // longest single wait
+    uint64_t wait_cycles;
+    uint64_t max_wait_cycles;
+    // Registration list link (lock_stats_register)
+    struct lock_stats* next;
+};
+
+typedef struct lock_stats lock_stats_t;
+
+struct spinlock {
+    // Ticket being served and next ticket handed out; the lock is free when
+    // they are equal. Adjacent halves of one word, `owner` in the low half.
+    volatile uint16_t owner;
+    volatile uint16_t next;
+#if LOCK_STATS
+    lock_stats_t stats;
+#endif
+};
+
+typedef struct spinlock spinlock_t;
+
+// Initializes `lock` unlocked, with statistics registered under `name` if it
+// is not NULL.
+void spin_lock_init(spinlock_t* lock, const char* name);
+// Acquires `lock`, spinning while another CPU holds it, and disables
+// preemption until spin_unlock.
+void spin_lock(spinlock_t* lock);
+// Acquires `lock` if it is free. Returns whether it did; preemption is only
+// disabled on success.
+bool spin_trylock(spinlock_t* lock);
+// Releases `lock` and re-enables preemption.
+void spin_unlock(spinlock_t* lock);
+// Disables interrupts, then acquires `lock`. Returns the previous EFLAGS for
+// spin_unlock_irqrestore.
+uint32_t spin_lock_irqsave(spinlock_t* lock);
+// Releases `lock` and restores the interrupt state saved by
+// spin_lock_irqsave.
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags);
+// Returns whether `lock` is currently held by anyone.
+bool spin_is_locked(const spinlock_t* lock);
+
+// Records an acquisition in `stats`; `wait_cycles` is 0 for an uncontended
+// one. Must be called by the new holder.
+void lock_stats_account(lock_stats_t* stats, bool contended, uint64_t wait_cycles);
+// Clears `stats` and, if `name` is not NULL, adds it to the list printed by
+// lock_print_stats. Used by the lock types that embed a lock_stats_t.
+void lock_stats_register(lock_stats_t* stats, const char* name);
+// Prints the statistics of every registered lock, in registration order.
+void lock_print_stats(void);
+
+#endif
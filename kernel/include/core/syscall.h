@@ -13,21 +13,118 @@
 #define SYSCALL_SUCCESS (0)
 #define SYSCALL_EINVAL (-22)
 #define SYSCALL_EFAULT (-14)
+#define SYSCALL_ENOMEM (-12)
+#define SYSCALL_EBUSY (-16)
+#define SYSCALL_ECHILD (-10)
+#define SYSCALL_EAGAIN (-11)
+#define SYSCALL_ETIMEDOUT (-110)
 
 // Temporary syscall numbers for MVP userland interactions.
 #define SYS_PRINT_STRING (0x1)
+// ebx = new break (0 queries). Returns the resulting break; unchanged on failure.
+#define SYS_BRK (0x2)
+// ebx = signed increment. Returns the previous break, or SYSCALL_ENOMEM.
+#define SYS_SBRK (0x3)
+// ebx = name, ecx = size in bytes. Opens the shm object called name, creating
+// it if needed. Returns its id.
+#define SYS_SHM_CREATE (0x4)
+// ebx = shm id. Returns the address it was attached at.
+#define SYS_SHM_ATTACH (0x5)
+// ebx = attach address returned by SYS_SHM_ATTACH.
+#define SYS_SHM_DETACH (0x6)
+// ebx = shm id. The object is freed once the last process detaches.
+#define SYS_SHM_DESTROY (0x7)
+// ebx = runtime, ecx = relative deadline, edx = period, all in microseconds.
+// Moves the caller to the EDF class; all zero releases its reservation.
+// Returns SYSCALL_EBUSY if admission control rejects it.
+#define SYS_SCHED_SETDEADLINE (0x8)
+// ebx = sched_dl_stats_t* to fill with the caller's EDF job counters.
+#define SYS_SCHED_DL_STATS (0x9)
+// ebx = seconds. Blocks the caller for at least that long.
+#define SYS_SLEEP (0xA)
+// ebx = const sys_timespec_t* duration, ecx = sys_timespec_t* remaining time
+// (may be NULL; always zero since sleeps are not interrupted).
+#define SYS_NANOSLEEP (0xB)
+// Gives up the CPU to other runnable processes. Always succeeds.
+#define SYS_SCHED_YIELD (0xC)
+// ebx = exit status. Ends the caller; its parent collects the status with
+// SYS_WAITPID. Does not return.
+#define SYS_EXIT (0xD)
+// ebx = child PID, or -1 for any child; ecx = int32_t* exit status (may be
+// NULL). Blocks until that child exits and returns its PID, or SYSCALL_ECHILD
+// if the caller has no such child.
+#define SYS_WAITPID (0xE)
+// ebx = sched_stats_t* (proc/scheduler.h) to fill with the system-wide switch
+// count and latency histograms. NULL prints every task's counters and the
+// histograms on the console instead.
+#define SYS_SCHED_STATS (0xF)
+// ebx = PID, or -1 for the caller; ecx = sched_proc_stats_t* to fill.
+// Returns SYSCALL_EINVAL for an unknown PID.
+#define SYS_SCHED_PROC_STATS (0x10)
+// ebx = uint32_t* futex word (4-byte aligned), ecx = FUTEX_WAIT or FUTEX_WAKE
+// (proc/futex.h). FUTEX_WAIT: edx = expected value, esi = timeout in
+// microseconds (0 waits forever); blocks while the word holds edx and returns
+// SYSCALL_SUCCESS when woken, SYSCALL_EAGAIN if the word differs or
+// SYSCALL_ETIMEDOUT. FUTEX_WAKE: edx = most processes to wake; returns how
+// many were woken. A word in an attached shm object is matched by physical
+// address, so shm mappings at different addresses work; any other word by
+// the caller's page directory and its virtual address.
+#define SYS_FUTEX (0x11)
+// ebx = SCHED_POLICY_FAIR or SCHED_POLICY_RR (proc/proc.h). Moves the caller to
+// that scheduling class, releasing its EDF reservation if it has one. Returns
+// SYSCALL_EINVAL for any other policy; EDF is entered with
+// SYS_SCHED_SETDEADLINE.
+#define SYS_SCHED_SETPOLICY (0x12)
 
 #define SYS_PRINT_STRING_MAX_LEN (256)
 
+// Layout copied out by SYS_SCHED_DL_STATS
+typedef struct sched_dl_stats {
+    uint32_t jobs;
+    uint32_t misses;
+    uint32_t overruns;
+    uint32_t reserved;
+} sched_dl_stats_t;
+
+// Layout copied out by SYS_SCHED_PROC_STATS (times in microseconds)
+typedef struct sched_proc_stats {
+    uint64_t run_time;
+    uint64_t wait_time;
+    uint64_t max_wait;
+    uint32_t voluntary_switches;
+    uint32_t involuntary_switches;
+} sched_proc_stats_t;
+
+// Duration passed to SYS_NANOSLEEP
+typedef struct sys_timespec {
+    uint32_t tv_sec;
+    uint32_t tv_nsec;
+} sys_timespec_t;
+
 typedef void (*syscall_handler_t)(int_regs_t* regs);
 
-// Checks if a virtual address within a process' page directory is accessible by user code.
-bool user_addr_accessible(const proc_t* proc, uint32_t addr);
 // Initializes the syscall dispatcher and hooks vector 0x80 into the IDT.
 void syscall_init(void);
 // Registers a handler for the syscall number `num`.
 int syscall_register(uint32_t num, syscall_handler_t handler);
 void syscall_dispatch(int_regs_t* regs);
 void sys_print_string(int_regs_t* regs);
+void sys_brk(int_regs_t* regs);
+void sys_sbrk(int_regs_t* regs);
+void sys_shm_create(int_regs_t* regs);
+void sys_shm_attach(int_regs_t* regs);
+void sys_shm_detach(int_regs_t* regs);
+void sys_shm_destroy(int_regs_t* regs);
+void sys_sched_setdeadline(int_regs_t* regs);
+void sys_sched_dl_stats(int_regs_t* regs);
+void sys_sleep(int_regs_t* regs);
+void sys_nanosleep(int_regs_t* regs);
+void sys_sched_yield(int_regs_t* regs);
+void sys_exit(int_regs_t* regs);
+void sys_waitpid(int_regs_t* regs);
+void sys_sched_stats(int_regs_t* regs);
+void sys_sched_proc_stats(int_regs_t* regs);
+void sys_futex(int_regs_t* regs);
+void sys_sched_setpolicy(int_regs_t* regs);
 
 #endif
@@ -0,0 +1,67 @@
+#ifndef _KERNEL_TIMER_H
+#define _KERNEL_TIMER_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Kernel timers on a hierarchical timing wheel, in units of ticks.
+//
+// Level 0 has one slot per tick for the next TIMER_TVR_SIZE ticks; each of the
+// TIMER_TVN_LEVELS upper levels has TIMER_TVN_SIZE slots covering
+// TIMER_TVN_SIZE times the range of a slot of the level below. Timers are
+// intrusive and unlinked in O(1); adding one is O(1) as well. Whenever level 0
+// wraps, the current slot of the next level is cascaded (re-added) downwards.
+// Expired timers run from the timer softirq (core/softirq.h) right after the
+// tick interrupt is acknowledged, with interrupts disabled.
+
+#define TIMER_TVR_BITS (8)
+#define TIMER_TVN_BITS (6)
+#define TIMER_TVR_SIZE (1 << TIMER_TVR_BITS)
+#define TIMER_TVN_SIZE (1 << TIMER_TVN_BITS)
+#define TIMER_TVN_LEVELS (4)
+// Timers further out than this many ticks expire after this many ticks
+#define TIMER_MAX_TICKS (0xFFFFFFFFu)
+
+typedef void (*timer_fn_t)(void* arg);
+
+struct ktimer {
+    struct ktimer* next;
+    // Link pointing at this timer, NULL while the timer is not pending
+    struct ktimer** pprev;
+    // tick_count value at which the timer expires
+    uint64_t expires;
+    timer_fn_t fn;
+    void* arg;
+};
+
+typedef struct ktimer ktimer_t;
+
+// Empties the wheel, starting it at the current tick_count.
+void timer_init(void);
+// Prepares `t` to call `fn(arg)` on expiry. `t` must not be pending.
+void timer_setup(ktimer_t* t, timer_fn_t fn, void* arg);
+// Arms `t` to expire at tick `expires` (re-arms it if it is pending). A tick in
+// the past expires at the next tick.
+void timer_add(ktimer_t* t, uint64_t expires);
+// Disarms `t`. Returns whether it was pending.
+bool timer_del(ktimer_t* t);
+// Returns whether `t` is armed and has not expired yet.
+bool timer_pending(const ktimer_t* t);
+// Called from the tick handler: raises SOFTIRQ_TIMER if any timer is pending
+// (skipping the wheel ahead otherwise).
+void timer_tick(void);
+// Runs every timer due up to the current tick_count. Called from the timer
+// softirq with interrupts disabled; catches up on ticks skipped while the tick
+// was stopped.
+void timer_run(void);
+// Returns the tick at which the earliest pending timer expires, or UINT64_MAX
+// if none is pending. O(wheel size + timers beyond level 0); used when going
+// tickless.
+uint64_t timer_next_expiry(void);
+// Returns the number of whole ticks covering `us` microseconds, rounded up.
+uint64_t timer_us_to_ticks(uint64_t us);
+// Blocks the current task (not the idle task) for at least `us`
+// microseconds. Interrupts must be disabled, as for scheduler_block.
+void timer_sleep_us(uint64_t us);
+
+#endif
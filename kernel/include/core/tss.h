@@ -35,10 +35,15 @@ typedef struct tss_entry {
     uint16_t iomap_base; // Offset to I/O permission bitmap; set to sizeof(tss)
 } __attribute__((packed)) tss_entry_t;
 
-// Writes the TSS descriptor into the GDT (index 5, selector 0x28), initializes
-// ss0/esp0, and loads TR via ltr. Uses an internal kernel-only stack initially.
-void tss_init(void);
-// Updates the kernel stack pointer used on privilege elevation.
+struct cpu;
+
+// Initializes the TSS of per-CPU area `cpu`, writes its descriptor into the
+// CPU's GDT (index 5, selector 0x28) and loads TR via ltr on the calling CPU.
+// ESP0 starts at the CPU's boot stack, or an internal kernel-only stack on the
+// boot processor.
+void tss_init(struct cpu* cpu);
+// Updates the kernel stack pointer used on privilege elevation by the calling
+// CPU.
 void tss_set_kernel_stack(uint32_t kstack_top);
 
 // Assembly helper that loads TR with the given selector (e.g., 0x28).
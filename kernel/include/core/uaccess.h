@@ -0,0 +1,49 @@
+#ifndef _KERNEL_UACCESS_H
+#define _KERNEL_UACCESS_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Kernel access to user memory. Ranges are checked once against the user half
+// of the address space; the copy itself runs at memory speed (rep movs) and is
+// allowed to fault. Not-present pages are demand-faulted as usual; a fault
+// that cannot be resolved makes `page_fault` resume at the routine's fixup
+// code, found through the exception table, which reports the failure instead
+// of panicking.
+
+// First address above user space (start of the kernel window)
+#define USER_SPACE_END (0xC0000000)
+
+// One exception table entry: a kernel instruction allowed to fault on user
+// memory and where to continue when it does. Emitted by assembly into the
+// `__ex_table` section, bounded by `_ex_table_start`/`_ex_table_end`.
+struct exception_table_entry {
+    uint32_t insn;
+    uint32_t fixup;
+};
+
+typedef struct exception_table_entry exception_table_entry_t;
+
+// Returns whether [addr, addr + size) lies entirely in user space. Does not
+// check that the pages are mapped.
+bool access_ok(const void* addr, size_t size);
+// Copies `n` bytes from user address `user_src` to kernel buffer `dst`.
+// Returns the number of bytes that could NOT be copied (0 on success).
+size_t copy_from_user(void* dst, const void* user_src, size_t n);
+// Copies `n` bytes from kernel buffer `src` to user address `user_dst`.
+// Returns the number of bytes that could NOT be copied (0 on success).
+size_t copy_to_user(void* user_dst, const void* src, size_t n);
+// Copies a NUL-terminated string of at most `n` bytes from `user_src` into
+// `dst`. Returns the string length if a NUL was copied, `n` if none was found
+// within `n` bytes (dst is then not terminated), or SYSCALL_EFAULT.
+int32_t strncpy_from_user(char* dst, const char* user_src, size_t n);
+// Returns the fixup address registered for faulting kernel instruction `eip`,
+// or 0 if `eip` is not allowed to fault.
+uint32_t search_exception_table(uint32_t eip);
+
+// Raw copy loops (ucopy.S). No range checks; use the wrappers above.
+extern uint32_t __copy_user(void* dst, const void* src, uint32_t n);
+extern int32_t __strncpy_user(char* dst, const char* src, uint32_t n);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _KERNEL_ATA_H
+#define _KERNEL_ATA_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ATA_SECTOR_SIZE (512)
+
+// Primary bus I/O ports (legacy ISA compatibility mode)
+#define ATA_PRIMARY_IO (0x1F0)
+#define ATA_PRIMARY_CTRL (0x3F6)
+
+// Offsets from the I/O base
+#define ATA_REG_DATA (0x0)
+#define ATA_REG_ERROR (0x1)
+#define ATA_REG_SECCOUNT (0x2)
+#define ATA_REG_LBA0 (0x3)
+#define ATA_REG_LBA1 (0x4)
+#define ATA_REG_LBA2 (0x5)
+#define ATA_REG_DRIVE (0x6)
+#define ATA_REG_STATUS (0x7)
+#define ATA_REG_COMMAND (0x7)
+
+#define ATA_CMD_READ_PIO (0x20)
+#define ATA_CMD_WRITE_PIO (0x30)
+#define ATA_CMD_CACHE_FLUSH (0xE7)
+#define ATA_CMD_IDENTIFY (0xEC)
+
+#define ATA_SR_BSY (0x80)
+#define ATA_SR_DRDY (0x40)
+#define ATA_SR_DF (0x20)
+#define ATA_SR_DRQ (0x08)
+#define ATA_SR_ERR (0x01)
+
+// Probes the primary master with IDENTIFY. Returns true if an ATA disk is
+// present; its LBA28 capacity is then available from `ata_sector_count`.
+// Polling only: the drive's IRQ (14) is disabled via nIEN.
+bool ata_init(void);
+// Returns the number of addressable 512-byte sectors on the probed disk, or 0
+// if `ata_init` found none.
+uint32_t ata_sector_count(void);
+// Reads `count` sectors starting at `lba` into `buf` (kernel virtual address,
+// `count` * ATA_SECTOR_SIZE bytes) with PIO. Returns 0 on success, -1 on error.
+int ata_read(uint32_t lba, uint32_t count, void* buf);
+// Writes `count` sectors starting at `lba` from `buf` with PIO and flushes the
+// drive's write cache. Returns 0 on success, -1 on error.
+int ata_write(uint32_t lba, uint32_t count, const void* buf);
+
+#endif
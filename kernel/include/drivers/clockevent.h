@@ -0,0 +1,68 @@
+#ifndef _KERNEL_CLOCKEVENT_H
+#define _KERNEL_CLOCKEVENT_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Clock event devices and the system tick.
+//
+// A clock event device is a programmable timer interrupt source (PIT, HPET
+// comparator, LAPIC timer). The best registered device drives the tick, which
+// runs expired kernel timers, scheduler_tick and periodic housekeeping. While
+// the CPU idles with nothing queued the periodic tick is stopped ("nohz") and
+// the device is programmed in one-shot mode for the earliest pending event;
+// the tick is restarted as soon as the CPU wakes up, and the ticks skipped in
+// between are added to `tick_count` from the TSC.
+
+#define CLOCK_EVT_FEAT_PERIODIC (1 << 0)
+#define CLOCK_EVT_FEAT_ONESHOT (1 << 1)
+
+// Idle periods shorter than this many ticks keep the periodic tick running
+#define TICK_NOHZ_MIN_TICKS (2)
+
+struct clock_event_device {
+    const char* name;
+    // CLOCK_EVT_FEAT_* flags
+    uint32_t features;
+    // The device with the highest rating drives the tick
+    uint32_t rating;
+    // Range of one-shot delays the device can be programmed with
+    uint64_t min_delta_us;
+    uint64_t max_delta_us;
+    // Starts periodic interrupts at `hz`.
+    void (*set_periodic)(uint32_t hz);
+    // Raises one interrupt `delta_us` from now; `delta_us` is within range.
+    void (*set_next_event)(uint64_t delta_us);
+    // Stops all interrupts of the device.
+    void (*shutdown)(void);
+};
+
+typedef struct clock_event_device clock_event_device_t;
+
+// Ticks since tick_init, including those skipped while the tick was stopped
+extern volatile uint64_t tick_count;
+
+// Makes `dev` the tick device if no device with a higher rating is registered.
+// A device taking over a running tick is switched to the current mode.
+void clockevent_register(const clock_event_device_t* dev);
+// Called from the tick device's interrupt handler, with interrupts disabled.
+void clockevent_handle_interrupt(void);
+
+// Starts the periodic tick at `hz` on the registered device.
+void tick_init(uint32_t hz);
+// Returns the tick period in microseconds.
+uint32_t tick_period_us(void);
+// Stops the periodic tick if the scheduler is idle, the device supports
+// one-shot mode and the next pending event (kernel timer or scheduler event)
+// is at least TICK_NOHZ_MIN_TICKS away; the device then fires once for that
+// event (or after its maximum delay).
+// Called by the idle task with interrupts disabled, right before halting.
+void tick_nohz_idle_enter(void);
+// Restarts the periodic tick if it was stopped and accounts the skipped ticks.
+// Called when the CPU leaves idle; does nothing if the tick is running.
+void tick_nohz_idle_exit(void);
+// Prints timer interrupts per second since tick_init and time spent with the
+// tick stopped.
+void tick_print_stats(void);
+
+#endif
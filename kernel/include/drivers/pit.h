@@ -4,9 +4,16 @@
 #include <stdint.h>
 #include <core/isr.h>
 
-// Programs the legacy PIT (8253/8254) to generate periodic IRQ0 at the desired
-// `frequency` (Hz): installs an ISR for vector 32, configures PIT mode and
-// divisor via I/O ports 0x43/0x40. `frequency` is a scalar (not a time period).
+// PIT input clock (Hz)
+#define PIT_HZ (1193182)
+// One-shot range of channel 0: one input clock up to a full 16-bit count
+#define PIT_MIN_DELTA_US (1)
+#define PIT_MAX_DELTA_US (54900)
+
+// Registers the legacy PIT (8253/8254) channel 0 as a clock event device
+// (periodic square wave or one-shot interrupt on terminal count, on IRQ0 /
+// vector 32) and starts the system tick at `frequency` Hz through it.
+// `frequency` is a scalar (not a time period).
 void pit_init(uint32_t frequency);
 
 #endif
@@ -0,0 +1,25 @@
+#ifndef _KERNEL_TSC_H
+#define _KERNEL_TSC_H 1
+
+#include <stdint.h>
+
+// PIT input clock (Hz), used as the reference for calibration
+#define TSC_PIT_HZ (1193182)
+// Length of the calibration window in milliseconds
+#define TSC_CALIBRATE_MS (10)
+
+// Calibrates the time-stamp counter against PIT channel 2 (one-shot over
+// TSC_CALIBRATE_MS, polled through port 0x61) and records the boot reference
+// point for `tsc_us`. Assumes an invariant TSC. Must run with interrupts
+// disabled, before anything reads `tsc_us`.
+void tsc_init(void);
+// Returns the calibrated TSC frequency in kHz (cycles per millisecond).
+uint64_t tsc_khz(void);
+// Converts a number of TSC cycles to microseconds.
+uint64_t tsc_cycles_to_us(uint64_t cycles);
+// Converts a (small) number of TSC cycles to nanoseconds.
+uint64_t tsc_cycles_to_ns(uint64_t cycles);
+// Returns microseconds elapsed since `tsc_init`.
+uint64_t tsc_us(void);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef _KERNEL_IMAGE_H
+#define _KERNEL_IMAGE_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mm/paging.h>
+
+// Executable image cache. An image is a program held in memory (a multiboot
+// module, or code built by the kernel), identified by its physical location.
+// Every process started from the same image shares it through its areas
+// (mm/vma.h): read-only pages that can be mapped straight from the image are,
+// and those that cannot (a page holding the tail of .text and the start of
+// .rodata, a segment not page-aligned in the file) are filled once into a
+// frame owned by the image and mapped into every process. An image is
+// reference-counted by the areas built on it; its frames are freed with the
+// last reference. Only writable data, .bss, heap and stack stay per process.
+
+// A page of an image filled for the read-only area page at `vaddr`
+struct image_page {
+    uint32_t vaddr;
+    uint32_t frame;   // PHYSICAL address of the filled frame
+    struct image_page* next;
+};
+
+typedef struct image_page image_page_t;
+
+struct image {
+    uint32_t phys;      // physical address of the image bytes
+    uint32_t size;
+    uint32_t refcount;
+    image_page_t* pages;
+    uint32_t nr_pages;
+    struct image* next;
+};
+
+typedef struct image image_t;
+
+// Returns the image of `size` bytes at PHYSICAL address `phys` with a new
+// reference, adding it to the cache if no process uses it yet. Returns NULL
+// if out of kernel heap.
+image_t* image_get(uint32_t phys, uint32_t size);
+// Takes another reference on `image`.
+void image_hold(image_t* image);
+// Drops a reference; the last one frees the filled frames and removes the
+// image from the cache (the image bytes themselves are left alone).
+void image_put(image_t* image);
+// Returns the PHYSICAL address of the frame filled for `vaddr`, or 0 if none.
+uint32_t image_page_lookup(const image_t* image, uint32_t vaddr);
+// Records `frame` as the filled frame for `vaddr`; the image owns it from now
+// on. Returns -1 if out of kernel heap (the frame then stays with the caller).
+int image_page_insert(image_t* image, uint32_t vaddr, uint32_t frame);
+// Prints every cached image with its reference count and filled frames.
+void image_print_stats(void);
+
+#endif
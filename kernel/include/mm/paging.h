@@ -8,6 +8,8 @@
 
 #define PAGE_SIZE (0x1000)
 #define PAGE_TABLE_SIZE (0x400000)
+#define HUGE_PAGE_SIZE (0x400000)
+#define HUGE_PAGE_FRAMES (HUGE_PAGE_SIZE / PAGE_SIZE)
 #define EOM (0xFFFFFFFF)
 #define KERN_START_TBL (768)
 #define KERN_HIGHMEM_START_TBL (992)
@@ -25,7 +27,7 @@
 
 #define PAGE_PADDR(x) ((x) * 0x1000)
 
-#define PAGE_ROUND_DOWN(x) ((x) & 0xFFFFF000);
+#define PAGE_ROUND_DOWN(x) ((x) & 0xFFFFF000)
 #define PAGE_ROUND_UP(x) (((x) % 0x1000) ? (((x) & 0xFFFFF000) + 0x1000) : (x))
 
 #define PAGE_DIR_IDX(x) ((uint32_t)(x) / 0x400000)
@@ -42,14 +44,26 @@ struct page {
     uint32_t present    : 1;   // Present in memory if set
     uint32_t rw         : 1;   // Readwrite if set
     uint32_t user       : 1;   // User mode if set
+    uint32_t write_thru : 1;   // Write through cache if set
+    uint32_t disable_cache : 1;   // Disable cache if set
     uint32_t accessed   : 1;   // Has the page been accessed since last refresh?
     uint32_t dirty      : 1;   // Has the page been written to since last refresh?
-    uint32_t unused     : 7;   // Unused / reserved bits
+    uint32_t pat        : 1;   // Page attribute table index bit
+    uint32_t global     : 1;   // Not flushed on CR3 reload if set (needs CR4.PGE)
+    uint32_t avail      : 3;   // Ignored by the MMU, see PAGE_AVAIL_*
     uint32_t frame      : 20;  // Frame address (shifted right 12 bits)
 } __attribute__((packed));
 
 typedef struct page page_t;
 
+// Software bits kept in page_t.avail
+// Frame is not owned by this mapping; unmapping must not free it
+#define PAGE_AVAIL_SHARED (0b001)
+// Mapping of the global zero frame (always together with PAGE_AVAIL_SHARED)
+#define PAGE_AVAIL_ZERO (0b010)
+// Not present: page lives in swap, `frame` holds the swap slot number
+#define PAGE_AVAIL_SWAP (0b100)
+
 typedef uint8_t pmm_flags_t;
 
 #define PMM_FLAGS_DEFAULT ((uint8_t)0)
@@ -85,9 +99,12 @@ struct page_directory {
 typedef struct page_directory page_directory_t;
 
 // Handles CPU exception 14 (page fault). Reads CR2 to obtain the faulting
-// linear address (virtual address), decodes the error code in the provided
-// `int_regs_t` (pushed by the ISR stub), and reports whether the fault was due
-// to not-present, write, user-mode, or reserved-bit violations. Does not return.
+// linear address (virtual address). Faults on user addresses in a process
+// address space are first offered to `umm_handle_fault` (lazy heap pages);
+// if that resolves the fault, returns and the access is retried. Otherwise
+// decodes the error code in the provided `int_regs_t` (pushed by the ISR
+// stub), reports whether the fault was due to not-present, write, user-mode,
+// or reserved-bit violations, and panics.
 void page_fault(int_regs_t*);
 
 // Marks the 4 KiB physical frame containing physical address `addr` as used in
@@ -99,6 +116,9 @@ void clear_frame(uint32_t addr);
 // Returns whether the 4 KiB physical frame containing physical address `addr`
 // is currently marked used in the physical frame bitmap. `addr` is physical.
 bool test_frame(uint32_t addr);
+// Returns the number of physical frames currently marked used, reserved
+// regions included. Flat across process spawn/exit cycles.
+uint32_t pmm_used_frames(void);
 
 // Allocates `count` contiguous 4 KiB physical frames and marks them used in the
 // global frame bitmap. Flags: PMM_FLAGS_DEFAULT searches only "lowmem"
@@ -107,8 +127,13 @@ bool test_frame(uint32_t addr);
 // for
 // user pages or large buffers temporarily mapped via kmap(). Returns the base
 // PHYSICAL address (PAGE_SIZE-aligned) of the first frame, or 0 on failure; no
-// virtual mapping is created.
+// virtual mapping is created. When a single HIGHMEM frame is requested and
+// none is free, user pages are evicted to swap (`swap_out_page`) to make one.
 uint32_t alloc_pages(pmm_flags_t flags, uint32_t count);
+// Like `alloc_pages`, but the returned PHYSICAL base is a multiple of `align`
+// bytes (a power of two, at least PAGE_SIZE). Used for 4 MiB huge pages. Never
+// evicts to swap. Returns 0 on failure.
+uint32_t alloc_pages_aligned(pmm_flags_t flags, uint32_t count, uint32_t align);
 // Frees `count` contiguous 4 KiB physical frames starting at frame number
 // `frame` (i.e., the physical address is `frame * PAGE_SIZE`). Updates only the
 // frame bitmap; does not unmap any existing virtual mappings.
@@ -121,6 +146,24 @@ void swap_dir(page_directory_t* dir);
 // Invalidates the TLB for the current address space by reloading CR3 with its
 // current value. Does not modify any page structures; purely a hardware flush.
 void flush_tlb(void);
+// Invalidates the single TLB entry covering virtual address `vaddr` in the
+// current address space via `invlpg`. Cheaper than `flush_tlb` for one page.
+void invlpg(uint32_t vaddr);
+
+// Returns a kernel virtual pointer to the PTE mapping `vaddr` in `dir`, or
+// NULL if the covering page table does not exist or `vaddr` is covered by a
+// 4 MiB page (see `split_huge_page`). Does not allocate tables.
+page_t* get_page(page_directory_t* dir, uint32_t vaddr);
+
+// Sets CR4.PSE if the CPU supports 4 MiB pages. Called by `paging_init`.
+void enable_pse(void);
+// Returns whether 4 MiB page directory entries can be used.
+bool paging_pse_enabled(void);
+// Demotes the 4 MiB mapping in directory slot `pd_idx` of `dir` back to a page
+// table of 1024 PTEs over the same frames and protection, then flushes the
+// TLB. No-op (returns true) if the slot is not a huge mapping. Returns false if
+// no frame was available for the page table.
+bool split_huge_page(page_directory_t* dir, uint32_t pd_idx);
 
 // Marks a contiguous physical region [start, start+length) as reserved in the
 // frame bitmap. Rounds to page boundaries. Inputs are PHYSICAL byte addresses.
@@ -0,0 +1,60 @@
+#ifndef _KERNEL_SHM_H
+#define _KERNEL_SHM_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mm/paging.h>
+#include <proc/proc.h>
+
+// Named shared-memory objects. Each object owns one contiguous run of HIGHMEM
+// frames; attaching maps those same frames into the caller's address space, so
+// data written by one process is visible to every other attached process
+// without any copy through the kernel.
+
+#define SHM_MAX (32)
+#define SHM_NAME_MAX (32)
+// Attach window in every user address space, between heap and stack
+#define SHM_REGION_START (0x80000000)
+#define SHM_REGION_END (0xB0000000)
+
+struct shm {
+    uint32_t id;
+    char name[SHM_NAME_MAX];
+    uint32_t phys;      // physical base of the backing frames
+    uint32_t pages;
+    uint32_t refcount;  // attachments, plus one while the name is live
+    bool destroyed;     // name removed; freed once the last attachment goes
+};
+
+typedef struct shm shm_t;
+
+// One attachment of a shm object in a process, kept on `proc_t.shm_maps`.
+struct shm_mapping {
+    shm_t* shm;
+    uint32_t vaddr;
+    struct shm_mapping* next;
+};
+
+typedef struct shm_mapping shm_mapping_t;
+
+// Clears the global shm object table.
+void shm_init(void);
+// Looks up the object called `name`, creating it with `size` bytes (rounded up
+// to whole pages, zero-filled) if it does not exist yet. Returns the object id
+// (>= 0), or a negative SYSCALL_* error: SYSCALL_EINVAL if an existing object
+// is smaller than `size`, SYSCALL_ENOMEM if no slot or frames are available.
+int shm_create(const char* name, uint32_t size);
+// Maps object `id` into `proc` at the lowest free address of the attach
+// window. Returns the user virtual address, or 0 on failure.
+uint32_t shm_attach(proc_t* proc, uint32_t id);
+// Unmaps the attachment starting at user virtual address `vaddr` from `proc`
+// and drops its reference. Returns 0 on success, -1 if nothing is attached
+// there.
+int shm_detach(proc_t* proc, uint32_t vaddr);
+// Removes the name of object `id`. Its frames are returned to the PMM once no
+// process has it attached. Returns 0 on success, -1 for an unknown id.
+int shm_destroy(uint32_t id);
+// Detaches every object still attached to `proc` (process teardown).
+void shm_detach_all(proc_t* proc);
+
+#endif
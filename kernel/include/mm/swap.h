@@ -0,0 +1,39 @@
+#ifndef _KERNEL_SWAP_H
+#define _KERNEL_SWAP_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mm/paging.h>
+#include <drivers/ata.h>
+#include <proc/proc.h>
+
+// Swapping of private user pages to the primary ATA disk. The whole disk is
+// the swap area, split into page-sized slots tracked by a bitmap. Victims are
+// picked by a CLOCK (second chance) scan over the PTE accessed bits of every
+// user address space. An evicted page keeps its PTE with present=0, the slot
+// number in `frame` and PAGE_AVAIL_SWAP set; touching it faults it back in.
+
+#define SWAP_SECTORS_PER_SLOT (PAGE_SIZE / ATA_SECTOR_SIZE)
+// Slot numbers are stored in the 20-bit PTE frame field
+#define SWAP_MAX_SLOTS (1 << 20)
+
+// Probes the swap disk and allocates the slot bitmap. Swapping stays disabled
+// (and `swap_out_page` always fails) if no disk is found.
+void swap_init(void);
+// Returns whether a swap area is available.
+bool swap_enabled(void);
+// Runs the CLOCK hand until it finds a private user page whose accessed bit is
+// clear (clearing set bits as it passes), writes it to a free slot and frees
+// its frame. Returns 0 if a frame was freed, -1 if swap is disabled/full or no
+// page is evictable.
+int swap_out_page(void);
+// Brings the swapped-out page at `vaddr` in `proc` back into a fresh frame,
+// restores its mapping and releases the slot. `page` is its PTE. Returns 0 on
+// success, -1 on allocation or I/O failure.
+int swap_in_page(proc_t* proc, uint32_t vaddr, page_t* page);
+// Releases swap slot `slot` without reading it (the page was unmapped).
+void swap_free_slot(uint32_t slot);
+// Prints slot usage and the number of pages swapped out and in.
+void swap_print_stats(void);
+
+#endif
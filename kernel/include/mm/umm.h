@@ -0,0 +1,71 @@
+#ifndef _KERNEL_UMM_H
+#define _KERNEL_UMM_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mm/paging.h>
+#include <proc/proc.h>
+
+// User memory management: the per-process heap (program break) and demand
+// paging of anonymous user memory. Heap pages in [heap_start, brk) are only
+// backed by physical frames once they are first touched. A read of an
+// untouched page maps the single global zero frame read-only; the first write
+// to it faults again and gets a private zeroed frame. A write fault whose whole
+// 4 MiB-aligned block lies in the heap is served with one 4 MiB page, and a
+// periodic promotion pass collapses fully populated 4 KiB ranges into 4 MiB
+// pages to save TLB entries and page tables.
+
+// Ticks between promotion passes, and page directory slots examined per pass
+#define UMM_PROMOTE_INTERVAL (1000)
+#define UMM_PROMOTE_BUDGET (64)
+
+// Allocates and clears the global zero frame. Must run after the PMM is up and
+// before any user process touches its heap.
+void umm_init(void);
+
+// Returns the PHYSICAL address of the shared read-only zero frame.
+uint32_t umm_zero_frame(void);
+
+// Resolves a page fault at user virtual address `addr` in `proc`'s address
+// space. `err` is the page-fault error code pushed by the CPU. A page that was
+// swapped out is read back from swap, and one inside an image area is handed
+// to `vma_handle_fault` (mm/vma.h). If `addr` lies inside the process heap:
+// a read of an unmapped page maps the zero frame
+// read-only; a write to an unmapped page installs a zeroed 4 MiB page when
+// possible and otherwise, like a write to a page still backed by the zero
+// frame, a private zeroed HIGHMEM frame mapped user/writable. Returns
+// 0 if the fault was resolved and the access can be retried, -1 if it is a
+// genuine fault.
+int umm_handle_fault(proc_t* proc, uint32_t addr, uint32_t err);
+
+// Returns whether `addr` lies within `proc`'s heap, i.e. in a page that would
+// be populated on demand by `umm_handle_fault`.
+bool umm_addr_in_heap(const proc_t* proc, uint32_t addr);
+
+// Moves the program break of `proc` to `new_brk` (a user virtual address).
+// Growing only records the new break (pages are mapped lazily on first touch);
+// shrinking unmaps every page lying wholly above the new break and returns its
+// frame to the PMM. Returns 0 on success, -1 if `new_brk` is below
+// `heap_start` or beyond PROC_HEAP_LIMIT.
+int umm_set_brk(proc_t* proc, uint32_t new_brk);
+
+// Promotion pass: examines up to `budget` page directory slots of user address
+// spaces, resuming where the previous pass stopped, and collapses the first
+// 4 MiB range found whose 1024 PTEs are all present, private, user and of the
+// same protection into a single 4 MiB mapping backed by fresh contiguous
+// frames. Does nothing without PSE. Must run with interrupts disabled.
+void umm_promote_scan(uint32_t budget);
+// Prepares the promotion work item, which runs one promotion pass on the
+// system workqueue each time it is kicked. Call after workqueue_init.
+void umm_promote_start(void);
+// Queues a promotion pass; called from the tick handler every
+// UMM_PROMOTE_INTERVAL ticks.
+void umm_promote_kick(void);
+
+// Prints the per-process memory counters of every live process: heap pages
+// currently backed by the zero frame (frames saved), zero pages later written,
+// 4 MiB page coverage, and pages mapped from or copied out of the executable
+// image.
+void umm_print_stats(void);
+
+#endif
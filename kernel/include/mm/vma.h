@@ -0,0 +1,65 @@
+#ifndef _KERNEL_VMA_H
+#define _KERNEL_VMA_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <mm/paging.h>
+#include <proc/proc.h>
+#include <mm/image.h>
+
+// Virtual memory areas: page-aligned ranges of a user address space that are
+// populated on demand from an executable image already in memory (mm/image.h).
+// Nothing is mapped when an area is created; the first access to each page
+// faults and is resolved from the image:
+// - a page wholly backed by a page-aligned run of the image is mapped straight
+//   to the image frame, read-only and shared (avail PAGE_AVAIL_SHARED); in a
+//   writable area the first write replaces it with a private copy
+// - a page lying past the file-backed part (.bss) is mapped to the zero frame
+//   until written, like untouched heap memory
+// - any other page (partly file-backed, or an image run that is not page
+//   aligned) is filled from the image and zero-padded: once per image into a
+//   shared frame of the image cache in a read-only area, into a private frame
+//   in a writable one
+// The image itself is never written and must stay allocated for as long as
+// any process maps it.
+
+#define VMA_READ (1 << 0)
+#define VMA_WRITE (1 << 1)
+#define VMA_EXEC (1 << 2)
+
+struct vm_area {
+    uint32_t start;      // first page of the area
+    uint32_t end;        // first page past the area
+    uint32_t flags;      // VMA_*
+    // [file_start, file_end) holds the image bytes starting at PHYSICAL
+    // address `file_phys`; the rest of the area reads as zero
+    uint32_t file_start;
+    uint32_t file_end;
+    uint32_t file_phys;
+    // Image the bytes come from; the area holds a reference
+    image_t* image;
+    struct vm_area* next;
+};
+
+typedef struct vm_area vm_area_t;
+
+// Allocates an area covering [start, end) (rounded out to whole pages) whose
+// bytes [file_start, file_end) come from offset `file_offset` of `image`, and
+// takes a reference on the image. Returns NULL if out of kernel heap.
+vm_area_t* vma_create(image_t* image, uint32_t start, uint32_t end, uint32_t flags, uint32_t file_start,
+    uint32_t file_end, uint32_t file_offset);
+// Links `vma` into the address-ordered list `*list`. Returns 0, or -1 if it
+// overlaps an area already on the list (which is left unchanged).
+int vma_insert(vm_area_t** list, vm_area_t* vma);
+// Returns the area of `list` containing user virtual address `addr`, or NULL.
+vm_area_t* vma_find(vm_area_t* list, uint32_t addr);
+// Frees every area of `*list`, dropping their image references, and empties
+// it. Pages already mapped from the areas are not touched.
+void vma_free_list(vm_area_t** list);
+// Resolves a page fault at `addr`, which lies in `vma` of `proc`'s address
+// space (see above). `err` is the page-fault error code. Returns 0 if the
+// access can be retried, -1 for a genuine fault (a write to a read-only area,
+// or out of memory).
+int vma_handle_fault(proc_t* proc, vm_area_t* vma, uint32_t addr, uint32_t err);
+
+#endif
@@ -12,7 +12,8 @@
 void* kmap(uint32_t paddr);
 // Unmaps a kernel virtual address previously returned by `kmap`. No-op for
 // NULL or addresses outside the kernel window. Clears the corresponding PTE in
-// the HIGHMEM window; does not free the underlying physical frame or flush TLB.
+// the HIGHMEM window and invalidates its TLB entry; does not free the
+// underlying physical frame.
 void kunmap(void* vaddr);
 
 #endif
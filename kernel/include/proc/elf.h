@@ -0,0 +1,71 @@
+#ifndef _KERNEL_ELF_H
+#define _KERNEL_ELF_H 1
+
+#include <stdint.h>
+#include <proc/proc.h>
+
+// Loader for static ELF32 i386 executables held in memory (multiboot
+// modules). Loading only parses the headers and records each PT_LOAD segment
+// as an area of the new address space (mm/vma.h); pages are brought in from
+// the image as the program touches them, so start-up cost does not grow with
+// the size of the binary.
+
+#define ELF_MAG0 (0x7F)
+#define ELF_MAG1 ('E')
+#define ELF_MAG2 ('L')
+#define ELF_MAG3 ('F')
+#define ELF_CLASS32 (1)
+#define ELF_DATA2LSB (1)
+#define ELF_ET_EXEC (2)
+#define ELF_EM_386 (3)
+#define ELF_EV_CURRENT (1)
+
+#define ELF_PT_LOAD (1)
+#define ELF_PF_X (1 << 0)
+#define ELF_PF_W (1 << 1)
+#define ELF_PF_R (1 << 2)
+
+// User stack given to loaded programs
+#define ELF_STACK_SIZE (4 * PAGE_SIZE)
+
+struct elf32_ehdr {
+    uint8_t e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint32_t e_entry;
+    uint32_t e_phoff;
+    uint32_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} __attribute__((packed));
+
+typedef struct elf32_ehdr elf32_ehdr_t;
+
+struct elf32_phdr {
+    uint32_t p_type;
+    uint32_t p_offset;
+    uint32_t p_vaddr;
+    uint32_t p_paddr;
+    uint32_t p_filesz;
+    uint32_t p_memsz;
+    uint32_t p_flags;
+    uint32_t p_align;
+} __attribute__((packed));
+
+typedef struct elf32_phdr elf32_phdr_t;
+
+// Creates a user process running the executable of `size` bytes at PHYSICAL
+// address `image`, which must lie in lowmem and stay allocated (text pages
+// are mapped straight from it). Processes loaded from the same image share its
+// read-only pages through the image cache (mm/image.h). Segments must lie
+// below the shm attach window. Returns the process, already queued, or NULL if
+// the image is not a valid static ELF32 i386 executable or memory runs out.
+proc_t* elf_load(uint32_t image, uint32_t size, procpriority_t priority);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef _KERNEL_FUTEX_H
+#define _KERNEL_FUTEX_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Futexes: user-space words a process can sleep on. Userspace locks and
+// condition variables keep their state in such a word and only enter the
+// kernel (SYS_FUTEX) to block while it holds some value or to wake sleepers
+// after changing it.
+//
+// A word inside an attached shm object is identified by its PHYSICAL
+// address, so processes mapping the object at different addresses meet on
+// the same key; shm frames are never swapped or collapsed, so the key stays
+// put. Any other word is identified by its address space and virtual
+// address: its frame is private and may move while a waiter sleeps (swap,
+// huge page promotion, first write to the zero frame), so a physical key
+// could strand the waiter. Waiters hang off a hashed bucket table, in FIFO
+// order per bucket, on their own kernel stacks and sleep through
+// scheduler_block.
+
+#define FUTEX_HASH_BITS (6)
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+// SYS_FUTEX operations
+#define FUTEX_WAIT (0)
+#define FUTEX_WAKE (1)
+
+// Blocks the current process while the aligned 32-bit word at user address
+// `uaddr` still holds `val`, until a FUTEX_WAKE on it or, if `timeout_us` is
+// not 0, until that many microseconds have passed. The comparison and going
+// to sleep are atomic with respect to wakers. Returns SYSCALL_SUCCESS once
+// woken, SYSCALL_EAGAIN if the word did not hold `val`, SYSCALL_ETIMEDOUT,
+// SYSCALL_EFAULT or SYSCALL_EINVAL. Interrupts must be disabled.
+int32_t futex_wait(uint32_t uaddr, uint32_t val, uint64_t timeout_us);
+// Wakes up to `count` processes waiting on the word at user address `uaddr`,
+// longest waiting first. Returns how many were woken, or SYSCALL_EFAULT /
+// SYSCALL_EINVAL. Interrupts must be disabled.
+int32_t futex_wake(uint32_t uaddr, uint32_t count);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef _KERNEL_MUTEX_H
+#define _KERNEL_MUTEX_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <proc/proc.h>
+#include <core/spinlock.h>
+
+// Sleeping mutexes for code that may block while holding the lock (disk I/O,
+// allocation that swaps, ...). A task that finds the mutex held first spins
+// for a while if the owner is running on another CPU, as it is then likely to
+// release it soon; otherwise it sleeps until the owner hands the mutex over.
+// With tasks scheduled on the BSP alone the owner is never running at that
+// point, so contended lockers go straight to sleep.
+//
+// Priority inheritance: while a task sleeps on a mutex, the owner runs at
+// least at the sleeper's priority, and so on down a chain of owners that are
+// themselves waiting (up to MUTEX_PI_MAX_DEPTH), so a low priority owner
+// cannot keep a high priority waiter off the CPU behind medium priority work.
+// Priority selects the fair class weight and the rr class level; EDF tasks
+// are unaffected. On unlock the mutex goes to its highest priority waiter
+// (the longest waiting among equals) and the old owner drops back to what
+// its remaining mutexes justify.
+//
+// All mutex bookkeeping is guarded by one internal spinlock. Mutexes must
+// only be used from task context, after kernel_proc_init, and not while
+// holding a spinlock or with preemption disabled.
+
+// Owner checks made by a contended locker before it sleeps
+#define MUTEX_SPIN_MAX (1000u)
+// Longest chain of owners boosted by one waiter
+#define MUTEX_PI_MAX_DEPTH (8u)
+
+struct mutex_waiter {
+    proc_t* proc;
+    struct mutex_waiter* next;
+};
+
+typedef struct mutex_waiter mutex_waiter_t;
+
+struct mutex {
+    // Holding task, NULL while free
+    proc_t* owner;
+    // Sleeping lockers in arrival order; entries live on their stacks
+    mutex_waiter_t* head;
+    mutex_waiter_t* tail;
+    // Next mutex held by `owner` (its `pi_held` list)
+    struct mutex* held_next;
+#if LOCK_STATS
+    lock_stats_t stats;
+#endif
+};
+
+typedef struct mutex mutex_t;
+
+// Initializes `m` unlocked, with statistics registered under `name` if it is
+// not NULL (see core/spinlock.h).
+void mutex_init(mutex_t* m, const char* name);
+// Acquires `m`, sleeping until it is free. Must not be called by its owner.
+void mutex_lock(mutex_t* m);
+// Acquires `m` if it is free. Returns whether it did.
+bool mutex_trylock(mutex_t* m);
+// Releases `m`, which the current task must hold, waking the waiter it is
+// handed to.
+void mutex_unlock(mutex_t* m);
+// Returns whether `m` is held by anyone.
+bool mutex_is_locked(const mutex_t* m);
+
+#endif
@@ -7,15 +7,33 @@
 #include <mm/paging.h>
 #include <core/common.h>
 #include <core/isr.h>
+#include <core/rbtree.h>
+#include <proc/wait.h>
 
-#define MAXPROC 64
+// PIDs are allocated from [0, PID_MAX); PID 0 is the kernel process
+#define PID_MAX 32768
+// Initial number of PID hash buckets; the table doubles whenever it holds more
+// than PROC_HASH_LOAD processes per bucket
+#define PROC_HASH_INIT 64
+#define PROC_HASH_LOAD 2
+// Per-process kernel stack size (whole lowmem pages)
+#define PROC_KSTACK_PAGES 2
 #define PROC_STACK_TOP 0xBFFFFFF0
+// Upper bound for the program break; the heap grows up from just past the
+// executable image and may never reach into the stack region.
+#define PROC_HEAP_LIMIT 0x80000000
+// proc_wait: wait for any child
+#define PROC_WAIT_ANY ((pid_t)-1)
+// Exit status of a process killed by an unresolved page fault
+#define PROC_EXIT_FAULT (-11)
 
-// Saved CPU context/trap frame used for process resumes and initial user entry.
-// Matches the ordering established by `interrupt.S` for PUSHAL + ISR pushes
-// and the CPU-pushed iret frame. Note: the `esp` within the PUSHAD block is
-// the KERNEL esp at interrupt time; `useresp`/`ss` are only present for CPL3
-// -> CPL0 transitions (user->kernel interrupts) and for user-mode iret frames.
+// CPU context for a direct jump to user mode with `iret_jump_user`. Matches
+// the ordering established by `interrupt.S` for PUSHAL and the CPU-pushed iret
+// frame. Note: the `esp` within the PUSHAD block is the KERNEL esp at
+// interrupt time; `useresp`/`ss` are only present for CPL3 -> CPL0
+// transitions (user->kernel interrupts) and for user-mode iret frames.
+// Scheduled processes keep their registers in an `int_regs_t` trap frame on
+// their kernel stack instead.
 struct context {
     // PUSHAD-saved general purpose registers (top of frame first)
     uint32_t edi, esi, ebp, esp, ebx, edx, ecx, eax;
@@ -32,6 +50,9 @@ enum procstate {
     PROC_SETUP,
     PROC_RUNNING,
     PROC_BLOCKED,
+    // Exited; keeps its PCB (and exit code) until the parent waits for it
+    PROC_ZOMBIE,
+    // Exited and queued for reclamation
     PROC_DESTROY
 };
 
@@ -45,16 +66,29 @@ enum procpriority {
 
 typedef enum procpriority procpriority_t;
 
+// Scheduling class a task belongs to (see proc/scheduler.h)
+enum sched_policy {
+    SCHED_POLICY_FAIR,
+    SCHED_POLICY_RR,
+    SCHED_POLICY_EDF
+};
+
+typedef enum sched_policy sched_policy_t;
+
 typedef uint32_t pid_t;
 
+struct shm_mapping;
+struct vm_area;
+struct mutex;
+
 struct proc {
     pid_t pid;
     page_directory_t* page_directory;
-    proc_context_t context;
     procstate_t procstate;
     procpriority_t priority;
-    void* brk;
-    void* heap_start;
+    sched_policy_t policy;
+    void* brk;        // current program break (first byte past the heap)
+    void* heap_start; // page-aligned start of the heap, just past the image
     void* stack_top;
     uint32_t stack_size;
     // Per-process kernel stack used on privilege elevation (TSS.ESP0)
@@ -63,46 +97,184 @@ struct proc {
     void* kstack_base;
     // Cached CR3 value (physical address of page directory) for fast context switches
     uint32_t cr3;
-    // Simple forward link for run queues (placeholder for future scheduler)
+    // Kernel stack pointer saved by switch_to while switched out; 0 while
+    // running. A user process's trap frame sits above it on the same stack.
+    uint32_t kesp;
+    // Runs only in ring 0 on `kernel_directory`; never has a user context
+    bool kthread;
+    // FXSAVE area, allocated the first time the task uses the FPU (core/fpu.h)
+    struct fpu_state* fpu;
+    // Heap pages currently mapped to the shared zero frame, i.e. frames saved
+    uint32_t zero_pages;
+    // Zero-frame mappings that were later written and given a private frame
+    uint32_t zero_page_cow;
+    // 4 MiB mappings currently held, and how many of them were collapsed
+    // from 4 KiB pages by the promotion pass (the rest were faulted in whole)
+    uint32_t huge_pages;
+    uint32_t huge_promotions;
+    // Pages of this process currently held in swap
+    uint32_t swap_pages;
+    // Attached shared-memory objects (see mm/shm.h)
+    struct shm_mapping* shm_maps;
+    // Areas populated on demand from the executable image (see mm/vma.h)
+    struct vm_area* vmas;
+    // Pages currently mapped straight to image frames, and private frames
+    // filled from the image (written data pages, partial pages)
+    uint32_t image_pages;
+    uint32_t image_copies;
+    // Set while the task sits in its class's run queue
+    bool on_rq;
+    // sched_clock() when the task was last put on the CPU or last charged
+    uint64_t exec_start;
+    // Total run time in microseconds, and its value when the current slice
+    // started
+    uint64_t sum_exec_runtime;
+    uint64_t slice_start_runtime;
+    // Switches away from the task while it was blocking or exiting
+    // (voluntary) and while it was still runnable (involuntary: preempted or
+    // yielding)
+    uint32_t nvcsw;
+    uint32_t nivcsw;
+    // sched_clock() when the task was last queued, 0 while not waiting; set
+    // along with `wait_wakeup` if it was queued by a wakeup or creation
+    uint64_t wait_start;
+    bool wait_wakeup;
+    // Total and longest time spent runnable but waiting for the CPU (us)
+    uint64_t wait_sum;
+    uint64_t wait_max;
+    // Fair class: weighted run time ordering `run_node` in the fair tree
+    uint64_t vruntime;
+    rb_node_t run_node;
+    // EDF class: declared reservation (microseconds): `dl_runtime` of CPU
+    // every `dl_period`, due `dl_deadline` after the period starts
+    uint64_t dl_runtime;
+    uint64_t dl_deadline;
+    uint64_t dl_period;
+    // EDF class: current job's absolute deadline and remaining budget, and
+    // the start of the next period
+    uint64_t dl_abs_deadline;
+    uint64_t dl_budget;
+    uint64_t dl_next_period;
+    // EDF class: budget used up, waiting for the next period
+    bool dl_throttled;
+    // EDF class: jobs started, deadlines passed with budget left, and jobs
+    // throttled for running past their budget
+    uint32_t dl_jobs;
+    uint32_t dl_misses;
+    uint32_t dl_overruns;
+    // RR class: priority the task is currently queued at, i.e. `priority`
+    // raised by aging while it waits, reset once it gets the CPU
+    procpriority_t dyn_priority;
+    // RR class: scheduling round in which the task was last enqueued (aging)
+    uint32_t enqueued_round;
+    // RR class: forward link within the run queue of `dyn_priority`
     struct proc* run_next;
+    // PID hash chain while registered; PCB cache free list once released
+    struct proc* hash_next;
+    // Process that created this one and may wait for it; NULL once the
+    // parent has exited. Children of PID 0 are reclaimed without a wait.
+    struct proc* parent;
+    // Children not reclaimed yet, linked through `sibling_next`/`sibling_prev`
+    struct proc* children;
+    struct proc* sibling_next;
+    struct proc* sibling_prev;
+    // proc_wait sleeps here until one of the children becomes a zombie
+    wait_queue_t child_exit_wq;
+    // Status passed to proc_exit, reported to the parent by proc_wait
+    int32_t exit_code;
+    // Priority the task was given; `priority` is raised above it while the
+    // task holds a mutex a higher priority task waits for (proc/mutex.h)
+    procpriority_t normal_priority;
+    // Mutexes currently held, linked through their `held_next`
+    struct mutex* pi_held;
+    // Mutex the task sleeps on, if any
+    struct mutex* pi_blocked_on;
 };
 
 typedef struct proc proc_t;
 
-// Global process table: array of pointers to process control blocks (PCBs).
-// Each `proc_t*` is a kernel virtual pointer; slots may be NULL or point to a
-// `proc_t` whose `procstate` indicates its lifecycle. Indexed by PID for now.
-extern proc_t* proc_list[MAXPROC];
+// Number of registered processes, including the kernel process
+extern uint32_t nr_procs;
 // Pointer to the currently running process’s PCB (kernel virtual pointer). May
 // be NULL during early boot or before the scheduler is initialized.
 extern proc_t* current_proc;
 
-// Initializes the process subsystem’s globals (`proc_list`, `current_proc`).
-// Does not allocate or create any processes; meant to be called at boot.
+// Initializes the process subsystem’s globals (PID bitmap, PID hash,
+// `current_proc`). Does not create any processes; meant to be called at boot
+// after the kernel heap is up.
 void proc_init(void);
+// Returns the registered process with PID `pid`, or NULL. O(1) on average.
+proc_t* proc_lookup(pid_t pid);
+// Returns the registered process with the lowest PID, or NULL if none.
+proc_t* proc_first(void);
+// Returns the registered process with the lowest PID above `pid`, or NULL.
+// `pid` need not be registered any more, so PIDs make safe scan cursors.
+proc_t* proc_next(pid_t pid);
+// Unregisters `proc`, releases its PID and FPU state and returns the PCB to
+// the PCB cache. Does not free its address space or stacks.
+void proc_free(proc_t* proc);
 // Creates and registers PID 0 as the kernel process. Sets `current_proc` and
 // points its `page_directory` at the global kernel directory (shared address space).
 void kernel_proc_init(void);
 // Maps `pages` pages starting at `phys` to `virt` in the given process's page directory.
 // Returns 0 on success, -1 on failure.
 int proc_map_pages(proc_t* proc, uint32_t virt, uint32_t phys, uint32_t pages, bool writable);
+// Unmaps `pages` pages starting at `virt` from the given process's page
+// directory and returns each mapped frame to the PMM, except frames marked
+// PAGE_AVAIL_SHARED which belong to someone else. Swapped-out pages release
+// their swap slot. 4 MiB mappings overlapping the range are split first.
+// Pages that are not mapped are skipped. Page tables themselves are kept.
+void proc_unmap_pages(proc_t* proc, uint32_t virt, uint32_t pages);
 // Creates a new user process with a private page directory cloned from the
 // kernel directory: allocates user stack pages (physical HIGHMEM) and maps them
-// into the process address space, sets initial context with `entry` (virtual).
-// Returns a kernel virtual pointer to the new `proc_t`, or NULL on failure.
+// into the process address space, and builds an initial trap frame entering
+// `entry` (virtual) on its kernel stack.
+// The heap starts at the first page boundary past [entry, entry + exec_size)
+// with an initial break `heap_size` bytes above it; heap pages are mapped
+// lazily on first touch. The process stays PROC_SETUP, so the caller can
+// finish its address space (mappings, VMAs) before proc_start, or undo it
+// with proc_destroy. Returns a kernel virtual pointer to the new `proc_t`,
+// or NULL on failure.
 proc_t* create_proc(void* entry, uint32_t exec_size, uint32_t stack_size, uint32_t heap_size, procpriority_t priority);
+// Makes process `proc`, fully set up after create_proc, runnable and queues
+// it.
+void proc_start(proc_t* proc);
+// Frees process `proc` with its whole address space (including its VMAs),
+// kernel stack and PID. Only for tasks that no longer run: never started
+// (PROC_SETUP) or reaped.
+void proc_destroy(proc_t* proc);
 
-// Transfers control to user mode for process `p` by switching to its address
-// space, updating TSS.ESP0 to its kernel stack, and executing an iret path.
-// Requires that `p->context` is initialized appropriately.
-void proc_enter(proc_t* p);
+// Creates a kernel thread that runs `fn(arg)` on its own kernel stack and
+// queues it at `priority`. Kernel threads share the kernel half of whatever
+// address space is loaded, so switching to one never reloads CR3. They run
+// with interrupts enabled and can be preempted at any IRQ, so shared kernel
+// state must only be touched with interrupts disabled. Returning from `fn`
+// ends the thread. Returns the new PCB, or NULL on failure.
+proc_t* kthread_create(void (*fn)(void*), void* arg, procpriority_t priority);
+// Ends the calling kernel thread. Does not return.
+__attribute__((noreturn)) void kthread_exit(void);
+// Ends the current task with status `code`: releases its whole user address
+// space (pages, page tables, swap slots, shared memory attachments), its FPU
+// state and EDF reservation, and turns it into a zombie for its parent to
+// collect. Children it leaves behind lose their parent. Tasks without a
+// waiting parent (parent exited, or PID 0) are reclaimed right away. Does not
+// return.
+__attribute__((noreturn)) void proc_exit(int32_t code);
+// Waits for a child of the current task to exit: `pid` names one child or is
+// PROC_WAIT_ANY. Reclaims the zombie (page directory, kernel stack, PCB),
+// stores its exit code in `*status` if `status` is not NULL and returns its
+// PID. Returns PROC_WAIT_ANY if there is no such child. Blocks while the
+// children exist but none has exited; interrupts must be disabled.
+pid_t proc_wait(pid_t pid, int32_t* status);
+// Frees every task queued for reclamation by proc_exit, except the current
+// one. Called by the scheduler, once a dead task has been switched away from.
+void proc_reap_dead(void);
+// Returns whether `proc`'s page directory is the one currently loaded in CR3,
+// i.e. whether changes to its page tables need a TLB flush on this CPU.
+bool proc_addr_space_active(const proc_t* proc);
 
 // Low-level iret jump to user mode using the provided saved context.
 // Does not return. Implemented in assembly.
 __attribute__((noreturn)) void iret_jump_user(proc_context_t* ctx);
 
-// Helpers for converting between interrupt register frames and stored contexts.
-void proc_context_from_regs(proc_context_t* dest, const int_regs_t* src);
-void proc_context_to_regs(int_regs_t* dest, const proc_context_t* src);
-
 #endif
\ No newline at end of file
@@ -2,20 +2,223 @@
 #define _KERNEL_SCHEDULER_H 1
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <proc/proc.h>
 #include <core/isr.h>
 
-// Default RR timeslice in seconds (at PIT frequency). Always enabled.
+// Scheduling classes. Every runnable task belongs to the class selected by its
+// `policy`; classes are consulted from highest to lowest and the first one with
+// a runnable task supplies the next task, so a queued SCHED_POLICY_RR task
+// always runs before any SCHED_POLICY_FAIR task.
+//
+// - edf: earliest deadline first for tasks with a declared reservation
+//   (runtime per period, relative deadline). Admission control keeps the
+//   total reserved utilization at or below SCHED_EDF_UTIL_MAX_PERMILLE; a task
+//   that exhausts its budget is throttled until its next period
+// - fair (default): CFS-style. Tasks are ordered by virtual runtime (run time
+//   scaled by 1024 / weight, weight from `priority`) in a red-black tree; the
+//   leftmost task runs for a share of SCHED_LATENCY_US proportional to its
+//   weight
+// - rr: static priority round robin over per-priority FIFO queues, with
+//   aging. Tasks opt in with SYS_SCHED_SETPOLICY
+//
+// Run time is charged in microseconds from the TSC on every tick and switch.
+
+// Timeslice of the round-robin class in seconds
 #ifndef SCHED_SLICE_SECONDS
 #define SCHED_SLICE_SECONDS 2u
 #endif
 
+// Fair class: period within which every runnable task should run once
+#define SCHED_LATENCY_US (20000u)
+// Fair class: shortest slice handed out; beyond SCHED_LATENCY_US /
+// SCHED_MIN_GRANULARITY_US tasks the period stretches instead
+#define SCHED_MIN_GRANULARITY_US (4000u)
+// Fair class: a woken task preempts the current one only if its vruntime is
+// smaller by more than this
+#define SCHED_WAKEUP_GRANULARITY_US (1000u)
+// Fair class: load weight of a task at nice 0 (PROC_PRIORITY_NORMAL)
+#define SCHED_WEIGHT_NORMAL (1024u)
+
+// EDF class: upper bound on the sum of runtime / period over admitted tasks
+#define SCHED_EDF_UTIL_MAX_PERMILLE (950u)
+// EDF class: fixed-point shift for utilization bookkeeping
+#define SCHED_EDF_UTIL_SHIFT (20)
+
+// One FIFO run queue per procpriority_t level (rr class)
+#define SCHED_LEVELS (PROC_PRIORITY_HIGH + 1)
+// A queued process that has been passed over for this many scheduling rounds
+// is moved up one level, so low priority work cannot starve forever.
+#ifndef SCHED_AGING_ROUNDS
+#define SCHED_AGING_ROUNDS 4u
+#endif
+
+// Histograms of the scheduler statistics: bucket 0 counts samples below 2
+// units, bucket i > 0 those in [2^i, 2^(i+1)); the last bucket also takes
+// everything larger.
+#define SCHED_HIST_BUCKETS (24)
+
+struct sched_hist {
+    uint32_t buckets[SCHED_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t sum;
+    uint64_t max;
+};
+
+typedef struct sched_hist sched_hist_t;
+
+// System-wide scheduler statistics, also copied out by SYS_SCHED_STATS
+struct sched_stats {
+    // Context switches (to a different task) since boot
+    uint64_t nr_switches;
+    // Microseconds from a task being woken (or created) until it runs
+    sched_hist_t wakeup_latency_us;
+    // Microseconds from a reschedule being requested (slice expiry or a
+    // preempting wakeup) until schedule() runs: how long the running task
+    // kept the CPU because it was not preemptible at the time
+    sched_hist_t resched_latency_us;
+    // Nanoseconds from entering schedule() until the next task resumes from
+    // switch_to, measured with the TSC (first runs of new tasks excluded)
+    sched_hist_t switch_cost_ns;
+};
+
+typedef struct sched_stats sched_stats_t;
+
+// Operations every scheduling class provides. Tasks handed to a class are not
+// the running task unless stated otherwise; the running task is not queued.
+struct sched_class {
+    const char* name;
+    // Queues runnable task `p`. `wakeup` is true when it was blocked or is new.
+    void (*enqueue)(proc_t* p, bool wakeup);
+    // Removes queued task `p`.
+    void (*dequeue)(proc_t* p);
+    // Requeues the running task `p`, which is being switched out but is still
+    // runnable.
+    void (*put_prev)(proc_t* p);
+    // Dequeues and returns the task to run next, or NULL if none is queued.
+    proc_t* (*pick_next)(void);
+    // Charges `delta_us` of run time to the running task `p`.
+    void (*update_curr)(proc_t* p, uint64_t delta_us);
+    // Returns whether the running task `p` has used up its slice.
+    bool (*slice_expired)(proc_t* p);
+    // Returns whether freshly queued `p` should preempt the running task
+    // `curr` of the same class.
+    bool (*check_preempt)(proc_t* curr, proc_t* p);
+    // Optional: called on every tick whatever is running (timers of the
+    // class, e.g. EDF replenishment).
+    void (*periodic)(uint64_t now);
+    // Optional: sched_clock time of the class's next timed event while
+    // nothing is queued (e.g. an EDF replenishment), or UINT64_MAX if none.
+    uint64_t (*next_event)(void);
+    // Optional: the running task `p` gives up the CPU (sched_yield); adjusts
+    // its state so that put_prev queues it behind its peers.
+    void (*yield)(proc_t* p);
+};
+
+typedef struct sched_class sched_class_t;
+
+extern const sched_class_t sched_edf_class;
+extern const sched_class_t sched_rr_class;
+extern const sched_class_t sched_fair_class;
+
+// Set when the running task should give up the CPU at the next IRQ exit
+extern volatile bool need_resched;
+// Nesting depth of preempt_disable sections. A single counter is enough as
+// there is one CPU; it is not saved per task, so a section must not block.
+extern volatile uint32_t preempt_count;
+
+// Keeps the running task on the CPU until the matching preempt_enable, even
+// if an interrupt requests a reschedule. Sections nest.
+void preempt_disable(void);
+// Ends a preempt_disable section; at the outermost level and with interrupts
+// on, runs softirqs held back meanwhile and switches away right away if a
+// reschedule was requested.
+void preempt_enable(void);
+// Explicit preemption point for long loops in the kernel: if preemption is
+// enabled, lets a pending interrupt in (briefly enabling interrupts if they
+// are off) and switches away if a reschedule is due. The caller's state must
+// be consistent across a switch. Returns whether another task ran meanwhile,
+// so that callers can revalidate what they were scanning.
+bool cond_resched(void);
+
+// Empties the run queues and adopts the calling context (PID 0, kmain) as the
+// idle task, run whenever nothing else is runnable.
 void scheduler_init(void);
-// Immediate yield from an interrupted state: saves current and switches to the
-// next runnable user process, if any.
-void scheduler_switch_next(int_regs_t* regs);
-void scheduler_switch_process(proc_t* next, int_regs_t* regs);
+// Queues runnable task `p` (new or woken) in its class and requests a
+// reschedule if it should preempt the running task. `p` must not already be
+// queued.
+void scheduler_enqueue(proc_t* p);
+// Removes `p` from its run queue if it is queued.
+void scheduler_dequeue(proc_t* p);
+// Moves `p` to scheduling class `policy`, requeueing it if it is queued. An EDF
+// reservation is released first; SCHED_POLICY_EDF itself is only entered
+// through scheduler_set_deadline and is ignored here. The running task is
+// rescheduled so that a higher class task can take over.
+void scheduler_set_policy(proc_t* p, sched_policy_t policy);
+// Per-tick hook called from the tick device: charges run time to the running
+// task and sets `need_resched` once its slice is used up.
+void scheduler_tick(void);
+// Returns whether the idle task is running and nothing is queued.
+bool scheduler_idle(void);
+// Returns the sched_clock time of the earliest timed event of any class, or
+// UINT64_MAX if none is pending. Used to program the tick while idle.
+uint64_t scheduler_next_event(void);
+// Microsecond clock used for run time accounting (TSC based).
+uint64_t sched_clock(void);
+// Returns the fair class load weight of `p` (from its priority).
+uint32_t sched_fair_weight(const proc_t* p);
+// Changes the priority `p` is scheduled at to `priority`, requeueing it if it
+// is queued and charging the running task its run time so far first. Used
+// for priority inheritance; `normal_priority` is left alone.
+void scheduler_set_priority(proc_t* p, procpriority_t priority);
+// Gives `p` an EDF reservation of `runtime_us` every `period_us`, due
+// `deadline_us` into each period, and moves it to SCHED_POLICY_EDF. Requires
+// 0 < runtime <= deadline <= period. Returns 0 on success, -1 for invalid
+// parameters, -2 if admitting it would exceed SCHED_EDF_UTIL_MAX_PERMILLE.
+int scheduler_set_deadline(proc_t* p, uint64_t runtime_us, uint64_t deadline_us, uint64_t period_us);
+// Releases the EDF reservation of `p`, if any, and moves it back to the fair
+// class.
+void scheduler_clear_deadline(proc_t* p);
+// Prints the reservation and job counters of every EDF task and the total
+// admitted utilization.
+void sched_edf_print_stats(void);
+// Copies the system-wide scheduler statistics to `out`.
+void sched_get_stats(sched_stats_t* out);
+// Prints the run time, wait time and switch counts of every task, followed by
+// the wakeup latency, scheduling latency and switch cost histograms.
+void sched_print_stats(void);
+// Picks the next task and switches kernel stacks to it. Must be called with
+// interrupts disabled; returns once the caller is scheduled again
+// (immediately if it keeps the CPU).
+void schedule(void);
+// Called by irq_handler after EOI: reschedules if `need_resched` is set or the
+// idle task is running while something is queued, unless preemption is
+// disabled (preempt_enable then does it). Does nothing until kmain enters
+// scheduler_idle_loop.
+void scheduler_irq_exit(void);
+// Marks the current task PROC_BLOCKED and schedules away from it. Interrupts
+// must be disabled; returns after scheduler_wake.
+void scheduler_block(void);
+// Makes blocked task `p` runnable again and queues it.
+void scheduler_wake(proc_t* p);
+// The current task gives up the CPU to any runnable peer: RR and fair tasks
+// queue behind the other tasks of their class, an EDF task ends its current
+// job. Interrupts must be disabled; returns when the task runs again.
+void sched_yield(void);
+// Body of the idle task (PID 0): halts until something is queued and switches
+// to it, stopping the tick while halted. Called by kmain once it is done with
+// initialization; never returns.
+__attribute__((noreturn)) void scheduler_idle_loop(void);
 
+// Requeues `cur` if it is still runnable (and not the idle task), then asks the
+// classes in order for the next task. May return `cur` itself; returns NULL if
+// nothing is runnable.
 proc_t* pick_next_proc(proc_t* cur);
 
+// Saves the callee-saved registers and kernel stack pointer of the running
+// task into *prev_kesp and resumes the task whose stack is at `next_kesp`.
+// Implemented in assembly (proc/switch.S).
+void switch_to(uint32_t* prev_kesp, uint32_t next_kesp);
+
 #endif
@@ -0,0 +1,55 @@
+#ifndef _KERNEL_WAIT_H
+#define _KERNEL_WAIT_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// proc_t embeds a wait queue, so proc/proc.h includes this header
+struct proc;
+
+// Wait queues: FIFO lists of tasks blocked until some condition holds. A
+// waiter's entry lives on its own kernel stack for as long as it sleeps; a
+// waker unlinks the entry before making the task runnable, so a task found
+// still linked after it wakes up was woken by something else (e.g. a
+// timeout). All functions must be called with interrupts disabled.
+
+struct wait_queue_entry {
+    struct proc* proc;
+    struct wait_queue_entry* next;
+};
+
+typedef struct wait_queue_entry wait_queue_entry_t;
+
+struct wait_queue {
+    wait_queue_entry_t* head;
+    wait_queue_entry_t* tail;
+};
+
+typedef struct wait_queue wait_queue_t;
+
+#define WAIT_QUEUE_INIT { NULL, NULL }
+
+// Sleeps on `wq` until `cond` holds. `cond` is re-evaluated after every
+// wakeup, with interrupts disabled.
+#define wait_event(wq, cond) \
+    do { \
+        while (!(cond)) { \
+            wait_queue_sleep(wq); \
+        } \
+    } while (0)
+
+// Empties `wq`.
+void wait_queue_init(wait_queue_t* wq);
+// Returns whether no task is waiting on `wq`.
+bool wait_queue_empty(const wait_queue_t* wq);
+// Appends the current task to `wq` and blocks it until woken.
+void wait_queue_sleep(wait_queue_t* wq);
+// Like wait_queue_sleep, but gives up after `timeout_us` microseconds. Returns
+// true if woken through `wq`, false on timeout.
+bool wait_queue_sleep_timeout(wait_queue_t* wq, uint64_t timeout_us);
+// Wakes the task waiting longest on `wq`. Returns whether there was one.
+bool wake_up_one(wait_queue_t* wq);
+// Wakes every task waiting on `wq`. Returns how many were woken.
+uint32_t wake_up_all(wait_queue_t* wq);
+
+#endif
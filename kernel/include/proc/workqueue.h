@@ -0,0 +1,65 @@
+#ifndef _KERNEL_WORKQUEUE_H
+#define _KERNEL_WORKQUEUE_H 1
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <proc/proc.h>
+#include <proc/wait.h>
+
+// Workqueues: FIFO lists of deferred work items, each serviced by its own
+// kernel worker thread. Unlike softirqs (core/softirq.h), work functions run
+// in process context with interrupts enabled and may block, allocate or take
+// as long as they like; they are scheduled like any other task of the
+// worker's priority. Items can be queued from any context, hard IRQ handlers
+// included.
+//
+// A work item is owned by its caller and queued at most once at a time:
+// queueing an item that is still pending is a no-op, so a burst of
+// interrupts collapses into a single run.
+
+struct work {
+    void (*fn)(void* arg);
+    void* arg;
+    struct work* next;
+    // Queued and not yet started
+    bool pending;
+};
+
+typedef struct work work_t;
+
+struct workqueue {
+    const char* name;
+    work_t* head;
+    work_t* tail;
+    // The worker sleeps here while the queue is empty
+    wait_queue_t wait;
+    proc_t* worker;
+    // Work items completed
+    uint64_t nr_done;
+    struct workqueue* next;
+};
+
+typedef struct workqueue workqueue_t;
+
+// Shared queue for work without special latency needs (schedule_work)
+extern workqueue_t* system_wq;
+
+// Creates the system workqueue. Needs the scheduler to be initialized.
+void workqueue_init(void);
+// Creates an empty queue called `name` and starts its worker thread at
+// `priority`. Returns NULL if out of memory.
+workqueue_t* workqueue_create(const char* name, procpriority_t priority);
+// Prepares `work` to call `fn(arg)`. `work` must not be pending.
+void work_init(work_t* work, void (*fn)(void*), void* arg);
+// Appends `work` to `wq` and wakes its worker. Returns false if `work` was
+// already pending (on any queue).
+bool queue_work(workqueue_t* wq, work_t* work);
+// queue_work on the system workqueue (false if there is none).
+bool schedule_work(work_t* work);
+// Removes `work` from `wq` if it has not started yet. Returns whether it was
+// pending; a run already in progress is not waited for.
+bool cancel_work(workqueue_t* wq, work_t* work);
+// Prints the backlog and completed item count of every workqueue.
+void workqueue_print_stats(void);
+
+#endif
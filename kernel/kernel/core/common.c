@@ -108,6 +108,16 @@ uint16_t inw(uint16_t port) {
    return ret;
 }  
 
+void outw(uint16_t port, uint16_t value) {
+   asm volatile ("outw %1, %0" : : "dN" (port), "a" (value));
+}
+
+uint64_t rdtsc(void) {
+   uint32_t lo, hi;
+   asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+   return ((uint64_t)hi << 32) | lo;
+}
+
 void cli() {
    asm volatile("cli");
 }
@@ -116,6 +126,24 @@ void sti() {
    asm volatile("sti");
 }
 
+uint32_t irq_save(void) {
+   uint32_t flags;
+   asm volatile("pushf; pop %0; cli" : "=r" (flags) : : "memory");
+   return flags;
+}
+
+void irq_restore(uint32_t flags) {
+   if (flags & EFLAGS_IF) {
+      asm volatile("sti" : : : "memory");
+   }
+}
+
+bool irqs_enabled(void) {
+   uint32_t flags;
+   asm volatile("pushf; pop %0" : "=r" (flags));
+   return flags & EFLAGS_IF;
+}
+
 void get_msr(uint32_t msr, uint32_t* lo, uint32_t* hi) {
    asm volatile("rdmsr":"=a"(*lo),"=d"(*hi):"c"(msr));
 }
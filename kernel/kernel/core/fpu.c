@@ -0,0 +1,140 @@
+#include <cpuid.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <core/fpu.h>
+#include <core/isr.h>
+#include <core/common.h>
+#include <mm/paging.h>
+#include <proc/proc.h>
+
+// Task whose state is live in the FPU registers, NULL if none
+static proc_t* fpu_owner = NULL;
+
+// Save area cache: pages are carved into FPU_STATE_SIZE areas (naturally
+// aligned), released areas are reused first
+static fpu_state_t* fpu_free_list = NULL;
+
+static fpu_state_t* fpu_state_alloc(void) {
+    if (!fpu_free_list) {
+        uint32_t page = alloc_pages(PMM_FLAGS_DEFAULT, 1);
+        if (!page) {
+            return NULL;
+        }
+        fpu_state_t* areas = (fpu_state_t*)KP2V(page);
+        for (uint32_t i = 0; i < PAGE_SIZE / sizeof(fpu_state_t); i++) {
+            *(fpu_state_t**)&areas[i] = fpu_free_list;
+            fpu_free_list = &areas[i];
+        }
+    }
+    fpu_state_t* state = fpu_free_list;
+    fpu_free_list = *(fpu_state_t**)state;
+    return state;
+}
+
+static void fpu_state_free(fpu_state_t* state) {
+    *(fpu_state_t**)state = fpu_free_list;
+    fpu_free_list = state;
+}
+
+static inline void clts(void) {
+    asm volatile("clts");
+}
+
+static inline void stts(void) {
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    asm volatile("mov %0, %%cr0" :: "r"(cr0 | CR0_TS));
+}
+
+static inline void fxsave(fpu_state_t* state) {
+    asm volatile("fxsave %0" : "=m"(*state));
+}
+
+static inline void fxrstor(const fpu_state_t* state) {
+    asm volatile("fxrstor %0" :: "m"(*state));
+}
+
+// #NM: the current task touched the FPU while CR0.TS was set
+static void fpu_handle_nm(int_regs_t* regs) {
+    (void)regs;
+    proc_t* p = current_proc;
+    clts();
+    if (fpu_owner == p) {
+        return;
+    }
+    if (fpu_owner) {
+        fxsave(fpu_owner->fpu);
+    }
+    fpu_owner = NULL;
+    if (!p->fpu) {
+        p->fpu = fpu_state_alloc();
+        if (!p->fpu) {
+            panic("fpu: out of memory for FPU state");
+        }
+        uint32_t mxcsr = FPU_MXCSR_DEFAULT;
+        asm volatile("fninit");
+        asm volatile("ldmxcsr %0" :: "m"(mxcsr));
+    } else {
+        fxrstor(p->fpu);
+    }
+    fpu_owner = p;
+}
+
+void fpu_init_cpu(void) {
+    uint32_t eax, ebx, ecx, edx;
+    // no leaf 1 means no feature flags: treated as neither being present
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+            !(edx & CPUID_FEAT_EDX_FXSR) || !(edx & CPUID_FEAT_EDX_SSE)) {
+        panic("fpu: FXSAVE/SSE not supported");
+    }
+    uint32_t cr0;
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(CR0_EM | CR0_TS);
+    cr0 |= CR0_MP | CR0_NE;
+    asm volatile("mov %0, %%cr0" :: "r"(cr0));
+    uint32_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    asm volatile("mov %0, %%cr4" :: "r"(cr4));
+    asm volatile("fninit");
+    stts();
+}
+
+void fpu_init(void) {
+    fpu_init_cpu();
+    isr_set_handler(7, fpu_handle_nm);
+    fpu_owner = NULL;
+}
+
+void fpu_switch(proc_t* next) {
+    if (next == fpu_owner) {
+        clts();
+    } else {
+        stts();
+    }
+}
+
+void fpu_release(proc_t* p) {
+    if (fpu_owner == p) {
+        fpu_owner = NULL;
+        stts();
+    }
+    if (p->fpu) {
+        fpu_state_free(p->fpu);
+        p->fpu = NULL;
+    }
+}
+
+void kernel_fpu_begin(void) {
+    clts();
+    if (fpu_owner) {
+        fxsave(fpu_owner->fpu);
+        fpu_owner = NULL;
+    }
+}
+
+void kernel_fpu_end(void) {
+    stts();
+}
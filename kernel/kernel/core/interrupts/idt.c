@@ -97,3 +97,7 @@ void idt_init() {
 
     idt_flush((uint32_t)(&idt_ptr));
 }
+
+void idt_load(void) {
+    idt_flush((uint32_t)(&idt_ptr));
+}
@@ -7,6 +7,8 @@
 #include <drivers/tty.h>
 #include <core/idt.h>
 #include <core/common.h>
+#include <core/softirq.h>
+#include <proc/scheduler.h>
 
 isr_t interrupt_handlers[256];
 uint32_t* apic_eoi;
@@ -19,17 +21,27 @@ void isr_handler(int_regs_t* registers) {
     } else {
         printf("received interrupt: code %d\n", registers->int_no);
     }
+    // returning to user mode is always a safe point to act on a reschedule
+    // requested by the handler (e.g. a syscall waking a more important task)
+    if((registers->cs & 3) == 3) {
+        scheduler_irq_exit();
+    }
     return;
 }
 
 // irq handler
 void irq_handler(int_regs_t* registers) {
     isr_t handler = interrupt_handlers[registers->int_no];
+    // handlers must not switch away (cond_resched in code they call is a
+    // no-op); the count drops without preempt_enable, as the switch has to
+    // wait for EOI anyway
+    preempt_count++;
     if(handler) {
         handler(registers);
     } else {
         printf("received interrupt: code %d\n", registers->int_no);
     }
+    preempt_count--;
     // eoi apic
     *apic_eoi = 0;
     // eoi slave pic
@@ -38,6 +50,10 @@ void irq_handler(int_regs_t* registers) {
     }
     // eoi master pic
     outb(0x20, 0x20);
+    // deferred work runs with the device acknowledged and interrupts enabled
+    do_softirq();
+    // preempt only after EOI: the switched-to task may not return here soon
+    scheduler_irq_exit();
     return;
 }
 
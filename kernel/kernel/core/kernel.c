@@ -16,9 +16,24 @@
 #include <mm/kmm.h>
 #include <mm/paging.h>
 #include <mm/vmm.h>
+#include <mm/umm.h>
+#include <mm/shm.h>
+#include <mm/swap.h>
+#include <mm/vma.h>
+#include <mm/image.h>
 #include <drivers/hpet.h>
 #include <proc/proc.h>
 #include <proc/scheduler.h>
+#include <proc/elf.h>
+#include <drivers/tsc.h>
+#include <drivers/clockevent.h>
+#include <core/timer.h>
+#include <core/fpu.h>
+#include <core/softirq.h>
+#include <core/smp.h>
+#include <core/spinlock.h>
+#include <proc/workqueue.h>
+#include <proc/mutex.h>
 
 #define USER_TEST_CODE_VA   0x00400000
 #define USER_TEST_DATA_VA   0x00401000
@@ -122,46 +137,54 @@ static void kernel_single_process_test(void) {
 }
 
 // --- Three-process scheduling demo ---
-// Creates three independent user processes. Each process maps its own code and
-// data page at identical virtual addresses, prints a unique message via
-// SYS_PRINT_STRING, then spins forever. The PIT preempts from user mode and
-// the simple RR scheduler alternates execution between them.
-static proc_t* make_user_proc_with_message(const char* msg) {
-    if (!msg) return NULL;
-
-    // Prepare user code/data pages (distinct physical frames per process)
-    uint32_t code_phys = alloc_pages(PMM_FLAGS_HIGHMEM, 1);
-    uint32_t data_phys = alloc_pages(PMM_FLAGS_HIGHMEM, 1);
-    if (!code_phys || !data_phys) {
-        printf("failed to allocate user pages\n");
+// Creates three independent user processes. They all run the same program:
+// one text page built once and shared read-only through the image cache, so
+// each extra process only costs its private data page and stack. The program
+// reads its parameters from the data page and prints its message via
+// SYS_PRINT_STRING once a second, sleeping with SYS_SLEEP in between.
+// `sleep_seconds` 0 makes the process print once and then spin forever
+// (CPU-bound load for the benchmarks); USER_DEMO_EXIT makes it print once and
+// exit with status 0.
+#define USER_DEMO_EXIT (0xFFFFFFFF)
+// Data page layout: message length, sleep_seconds, then the message
+#define USER_DEMO_LEN_OFF   0
+#define USER_DEMO_SLEEP_OFF 4
+#define USER_DEMO_MSG_OFF   16
+
+// Image holding the shared demo program; built on first use and kept
+static image_t* user_demo_text = NULL;
+
+static image_t* user_demo_text_image(void) {
+    if (user_demo_text) return user_demo_text;
+
+    uint32_t code_phys = alloc_pages(PMM_FLAGS_DEFAULT, 1);
+    if (!code_phys) {
+        printf("failed to allocate demo text page\n");
         return NULL;
     }
-
-    // Build the code and data via temporary kernel mappings
     uint8_t* code_ptr = (uint8_t*)kmap(code_phys);
-    char*    data_ptr = (char*)kmap(data_phys);
-    if (!code_ptr || !data_ptr) {
-        printf("kmap failed for user pages\n");
-        if (code_ptr) kunmap(code_ptr);
-        if (data_ptr) kunmap(data_ptr);
-        return NULL;
-    }
-
-    // Initialize pages
     memset(code_ptr, 0x90, PAGE_SIZE); // NOP pad
-    memset(data_ptr, 0x00, PAGE_SIZE);
 
-    // Stash message in data page at offset 0
-    size_t msg_len = strlen(msg);
-    memcpy(data_ptr, msg, msg_len);
-    data_ptr[msg_len] = '\0';
-
-    // Emit tiny user program:
+    // Emit the program:
+    // loop:
     //   mov eax, SYS_PRINT_STRING
-    //   mov ebx, USER_TEST_DATA_VA
-    //   mov ecx, msg_len
+    //   mov ebx, USER_TEST_DATA_VA + USER_DEMO_MSG_OFF
+    //   mov ecx, [USER_TEST_DATA_VA + USER_DEMO_LEN_OFF]
+    //   int 0x80
+    //   mov ebx, [USER_TEST_DATA_VA + USER_DEMO_SLEEP_OFF]
+    //   cmp ebx, USER_DEMO_EXIT
+    //   je exit
+    //   test ebx, ebx
+    //   jz spin
+    //   mov eax, SYS_SLEEP
+    //   int 0x80
+    //   jmp loop
+    // spin:
+    //   jmp spin
+    // exit:
+    //   mov eax, SYS_EXIT
+    //   xor ebx, ebx
     //   int 0x80
-    //   jmp $
     size_t idx = 0;
     uint32_t imm;
 
@@ -169,47 +192,121 @@ static proc_t* make_user_proc_with_message(const char* msg) {
     code_ptr[idx++] = 0xB8; // mov eax, imm32
     memcpy(&code_ptr[idx], &imm, sizeof(imm)); idx += sizeof(imm);
 
-    imm = USER_TEST_DATA_VA; // message at offset 0
+    imm = USER_TEST_DATA_VA + USER_DEMO_MSG_OFF;
     code_ptr[idx++] = 0xBB; // mov ebx, imm32
     memcpy(&code_ptr[idx], &imm, sizeof(imm)); idx += sizeof(imm);
 
-    imm = (uint32_t)msg_len;
-    code_ptr[idx++] = 0xB9; // mov ecx, imm32
+    imm = USER_TEST_DATA_VA + USER_DEMO_LEN_OFF;
+    code_ptr[idx++] = 0x8B; // mov ecx, [disp32]
+    code_ptr[idx++] = 0x0D;
+    memcpy(&code_ptr[idx], &imm, sizeof(imm)); idx += sizeof(imm);
+
+    code_ptr[idx++] = 0xCD; // int 0x80
+    code_ptr[idx++] = 0x80;
+
+    imm = USER_TEST_DATA_VA + USER_DEMO_SLEEP_OFF;
+    code_ptr[idx++] = 0x8B; // mov ebx, [disp32]
+    code_ptr[idx++] = 0x1D;
+    memcpy(&code_ptr[idx], &imm, sizeof(imm)); idx += sizeof(imm);
+
+    code_ptr[idx++] = 0x83; // cmp ebx, imm8 (sign-extended)
+    code_ptr[idx++] = 0xFB;
+    code_ptr[idx++] = (uint8_t)USER_DEMO_EXIT;
+
+    code_ptr[idx++] = 0x74; // je exit (patched below)
+    size_t je_exit = idx++;
+
+    code_ptr[idx++] = 0x85; // test ebx, ebx
+    code_ptr[idx++] = 0xDB;
+
+    code_ptr[idx++] = 0x74; // jz spin (patched below)
+    size_t jz_spin = idx++;
+
+    imm = SYS_SLEEP;
+    code_ptr[idx++] = 0xB8; // mov eax, imm32
     memcpy(&code_ptr[idx], &imm, sizeof(imm)); idx += sizeof(imm);
 
     code_ptr[idx++] = 0xCD; // int 0x80
     code_ptr[idx++] = 0x80;
 
-    code_ptr[idx++] = 0xEB; // jmp $
+    code_ptr[idx++] = 0xEB; // jmp loop (rel8 back to offset 0)
+    code_ptr[idx] = (uint8_t)(-(int32_t)(idx + 1));
+    idx++;
+
+    code_ptr[jz_spin] = (uint8_t)(idx - (jz_spin + 1));
+    code_ptr[idx++] = 0xEB; // spin: jmp $
     code_ptr[idx++] = 0xFE;
 
-    // Create process structure with entry at USER_TEST_CODE_VA and a 4 KiB stack
-    proc_t* p = create_proc((void*)USER_TEST_CODE_VA, 0, PAGE_SIZE, 0, PROC_PRIORITY_NORMAL);
-    if (!p) {
-        printf("two-proc test: create_proc failed\n");
-        kunmap(code_ptr);
-        kunmap(data_ptr);
+    code_ptr[je_exit] = (uint8_t)(idx - (je_exit + 1));
+    imm = SYS_EXIT;
+    code_ptr[idx++] = 0xB8; // exit: mov eax, imm32
+    memcpy(&code_ptr[idx], &imm, sizeof(imm)); idx += sizeof(imm);
+
+    code_ptr[idx++] = 0x31; // xor ebx, ebx
+    code_ptr[idx++] = 0xDB;
+
+    code_ptr[idx++] = 0xCD; // int 0x80
+    code_ptr[idx++] = 0x80;
+    kunmap(code_ptr);
+
+    user_demo_text = image_get(code_phys, PAGE_SIZE);
+    if (!user_demo_text) {
+        free_pages(PAGE_FRAME(code_phys), 1);
+    }
+    return user_demo_text;
+}
+
+static proc_t* make_user_proc_with_message(const char* msg, uint32_t sleep_seconds, procpriority_t priority) {
+    if (!msg) return NULL;
+    size_t msg_len = strlen(msg);
+    if (USER_DEMO_MSG_OFF + msg_len >= PAGE_SIZE) return NULL;
+
+    image_t* text = user_demo_text_image();
+    if (!text) return NULL;
+    // The text page is faulted in from the shared image on first use
+    vm_area_t* text_area = vma_create(text, USER_TEST_CODE_VA, USER_TEST_CODE_VA + PAGE_SIZE,
+        VMA_READ | VMA_EXEC, USER_TEST_CODE_VA, USER_TEST_CODE_VA + PAGE_SIZE, 0);
+    if (!text_area) {
+        printf("failed to allocate demo text area\n");
+        return NULL;
+    }
+
+    // Private data page holding the parameters
+    uint32_t data_phys = alloc_pages(PMM_FLAGS_HIGHMEM, 1);
+    if (!data_phys) {
+        printf("failed to allocate user pages\n");
+        vma_free_list(&text_area);
         return NULL;
     }
+    uint8_t* data_ptr = (uint8_t*)kmap(data_phys);
+    memset(data_ptr, 0x00, PAGE_SIZE);
+    uint32_t len = (uint32_t)msg_len;
+    memcpy(data_ptr + USER_DEMO_LEN_OFF, &len, sizeof(len));
+    memcpy(data_ptr + USER_DEMO_SLEEP_OFF, &sleep_seconds, sizeof(sleep_seconds));
+    memcpy(data_ptr + USER_DEMO_MSG_OFF, msg, msg_len);
+    kunmap(data_ptr);
 
-    // Map the prepared frames into the new process's address space
-    if (proc_map_pages(p, USER_TEST_CODE_VA, code_phys, 1, true) != 0) {
-        printf("two-proc test: map code failed\n");
-        kunmap(code_ptr);
-        kunmap(data_ptr);
+    // Create process structure with entry at USER_TEST_CODE_VA and a 4 KiB stack.
+    // The image spans the code and data pages, so the heap starts right after.
+    proc_t* p = create_proc((void*)USER_TEST_CODE_VA, 2 * PAGE_SIZE, PAGE_SIZE, 0, priority);
+    if (!p) {
+        printf("two-proc test: create_proc failed\n");
+        free_pages(PAGE_FRAME(data_phys), 1);
+        vma_free_list(&text_area);
         return NULL;
     }
+    p->vmas = text_area;
+
+    // Map the data frame into the new process's address space
     if (proc_map_pages(p, USER_TEST_DATA_VA, data_phys, 1, true) != 0) {
         printf("two-proc test: map data failed\n");
-        kunmap(code_ptr);
-        kunmap(data_ptr);
+        // the unmapped data frame is not part of the address space
+        proc_destroy(p);
+        free_pages(PAGE_FRAME(data_phys), 1);
         return NULL;
     }
-
-    // Drop temporary kernel mappings
-    kunmap(code_ptr);
-    kunmap(data_ptr);
-
+    // complete now: the first tick may run it
+    proc_start(p);
     return p;
 }
 
@@ -219,20 +316,227 @@ static void kernel_three_process_test(void) {
     const char* m2 = "[2] hello world from another process";
     const char* m3 = "[3] hello world from yet another process";
 
-    proc_t* p1 = make_user_proc_with_message(m1);
-    proc_t* p2 = make_user_proc_with_message(m2);
-    proc_t* p3 = make_user_proc_with_message(m3);
+    proc_t* p1 = make_user_proc_with_message(m1, 1, PROC_PRIORITY_NORMAL);
+    proc_t* p2 = make_user_proc_with_message(m2, 1, PROC_PRIORITY_NORMAL);
+    proc_t* p3 = make_user_proc_with_message(m3, 1, PROC_PRIORITY_NORMAL);
     if (!p1 || !p2 || !p3) {
         printf("three-proc test: failed to set up processes\n");
         return;
     }
 
     printf("Launching three user processes; scheduler should alternate prints...\n");
-    // Enter first process; PIT will preempt and round-robin to the second
-    printf("Jumping to first process, entering user mode for the first time via iret\n");
-    proc_enter(p1);
-    // Not reached unless something unusual occurs
-    printf("three-proc test: returned unexpectedly from user mode\n");
+    // The processes are queued; once kmain enters the idle loop PID 0
+    // switches to the first one
+}
+
+// --- Mutex priority inheritance self-test ---
+// A low priority kernel thread takes a mutex and starts a high priority one
+// that blocks on it. The holder must run at high priority while it is waited
+// on and drop back to low priority once it unlocks. The holder yields at most
+// PI_TEST_MAX_YIELDS times for the waiter to block.
+#define PI_TEST_MAX_YIELDS 100
+
+static mutex_t pi_test_mutex;
+
+static void pi_test_waiter(void* arg) {
+    (void)arg;
+    mutex_lock(&pi_test_mutex);
+    mutex_unlock(&pi_test_mutex);
+}
+
+static void pi_test_holder(void* arg) {
+    (void)arg;
+    proc_t* self = current_proc;
+    mutex_lock(&pi_test_mutex);
+    cli();
+    proc_t* waiter = kthread_create(pi_test_waiter, NULL, PROC_PRIORITY_HIGH);
+    for (uint32_t i = 0; waiter && waiter->pi_blocked_on != &pi_test_mutex &&
+            i < PI_TEST_MAX_YIELDS; i++) {
+        sched_yield();
+    }
+    procpriority_t boosted = self->priority;
+    sti();
+    // hands the mutex to the waiter, which may run right away
+    mutex_unlock(&pi_test_mutex);
+    procpriority_t restored = self->priority;
+    if (!waiter) {
+        printf("mutex PI test: failed to start the waiter\n");
+    } else if (boosted != PROC_PRIORITY_HIGH || restored != PROC_PRIORITY_LOW) {
+        printf("mutex PI test: FAILED, holder priority %u while waited on, %u after unlock\n",
+            (uint32_t)boosted, (uint32_t)restored);
+    } else {
+        printf("mutex PI test: passed\n");
+    }
+}
+
+static void kernel_mutex_pi_test(void) {
+    mutex_init(&pi_test_mutex, NULL);
+    if (!kthread_create(pi_test_holder, NULL, PROC_PRIORITY_LOW)) {
+        printf("mutex PI test: failed to start the holder\n");
+    }
+}
+
+// Reporters of the benchmarks below print after this long
+#define SCHED_BENCH_SECONDS 10
+
+#ifdef KERNEL_BENCH_FAIR
+// --- Fair-share benchmark ---
+// Runs a mix of CPU-bound processes at all three priorities under the fair
+// class. After SCHED_BENCH_SECONDS a reporter thread compares each process's
+// measured run time with its weighted share of the group's total run time and
+// prints the error per process and the worst case (in permille of the
+// expected share), followed by the scheduler, softirq, workqueue and lock
+// statistics. Built with -DKERNEL_BENCH_FAIR.
+#define SCHED_BENCH_PROCS 8
+
+static proc_t* bench_procs[SCHED_BENCH_PROCS];
+static const procpriority_t bench_prios[SCHED_BENCH_PROCS] = {
+    PROC_PRIORITY_LOW, PROC_PRIORITY_LOW, PROC_PRIORITY_LOW,
+    PROC_PRIORITY_NORMAL, PROC_PRIORITY_NORMAL, PROC_PRIORITY_NORMAL,
+    PROC_PRIORITY_HIGH, PROC_PRIORITY_HIGH,
+};
+
+static void fair_share_report(void* arg) {
+    (void)arg;
+    // the reporter sleeps; its own share is not part of the group
+    cli();
+    timer_sleep_us((uint64_t)SCHED_BENCH_SECONDS * 1000000);
+    uint64_t total_runtime = 0;
+    uint64_t total_weight = 0;
+    for (int i = 0; i < SCHED_BENCH_PROCS; i++) {
+        total_runtime += bench_procs[i]->sum_exec_runtime;
+        total_weight += sched_fair_weight(bench_procs[i]);
+    }
+    uint64_t max_error = 0;
+    for (int i = 0; i < SCHED_BENCH_PROCS; i++) {
+        proc_t* p = bench_procs[i];
+        uint64_t expected = total_runtime * sched_fair_weight(p) / total_weight;
+        uint64_t actual = p->sum_exec_runtime;
+        uint64_t diff = (actual > expected) ? actual - expected : expected - actual;
+        uint64_t error = expected ? diff * 1000 / expected : 0;
+        if (error > max_error) {
+            max_error = error;
+        }
+        printf("fair bench: pid %u weight %u: %llu ms run, %llu ms expected, error %llu permille\n",
+            p->pid, sched_fair_weight(p), actual / 1000, expected / 1000, error);
+    }
+    printf("fair bench: max error %llu permille over %llu ms\n", max_error, total_runtime / 1000);
+    sched_print_stats();
+    softirq_print_stats();
+    workqueue_print_stats();
+    lock_print_stats();
+    sti();
+}
+
+static void kernel_fair_share_bench(void) {
+    for (int i = 0; i < SCHED_BENCH_PROCS; i++) {
+        bench_procs[i] = make_user_proc_with_message("[bench] spinning", 0, bench_prios[i]);
+        if (!bench_procs[i]) {
+            printf("fair bench: failed to set up processes\n");
+            return;
+        }
+    }
+    if (!kthread_create(fair_share_report, NULL, PROC_PRIORITY_NORMAL)) {
+        printf("fair bench: failed to start reporter\n");
+    }
+}
+#endif
+
+#ifdef KERNEL_BENCH_EDF
+// --- EDF demo ---
+// Admits CPU-bound processes with (runtime, deadline, period) reservations next
+// to fair-class load and prints the EDF job counters after SCHED_BENCH_SECONDS.
+// Spinning tasks use up every budget, so each job ends in a throttle (overrun);
+// misses should stay at zero while admission control holds. Built with
+// -DKERNEL_BENCH_EDF.
+#define EDF_DEMO_PROCS 3
+
+static const uint32_t edf_demo_params[EDF_DEMO_PROCS][3] = {
+    { 2000, 10000, 10000 },
+    { 5000, 20000, 20000 },
+    { 10000, 50000, 50000 },
+};
+
+static void edf_demo_report(void* arg) {
+    (void)arg;
+    cli();
+    timer_sleep_us((uint64_t)SCHED_BENCH_SECONDS * 1000000);
+    sched_edf_print_stats();
+    sti();
+}
+
+static void kernel_edf_demo(void) {
+    for (int i = 0; i < EDF_DEMO_PROCS; i++) {
+        proc_t* p = make_user_proc_with_message("[edf] spinning", 0, PROC_PRIORITY_NORMAL);
+        if (!p) {
+            printf("edf demo: failed to set up processes\n");
+            return;
+        }
+        int rc = scheduler_set_deadline(p, edf_demo_params[i][0], edf_demo_params[i][1], edf_demo_params[i][2]);
+        if (rc != 0) {
+            printf("edf demo: pid %u not admitted (%d)\n", p->pid, rc);
+        }
+    }
+    if (!make_user_proc_with_message("[edf] fair load", 0, PROC_PRIORITY_NORMAL)) {
+        printf("edf demo: failed to set up fair load\n");
+    }
+    if (!kthread_create(edf_demo_report, NULL, PROC_PRIORITY_NORMAL)) {
+        printf("edf demo: failed to start reporter\n");
+    }
+}
+#endif
+
+#ifdef KERNEL_BENCH_SPAWN
+// --- Spawn/exit churn ---
+// A kernel thread repeatedly spawns a batch of short-lived processes that
+// print once and exit, waits for all of them and prints the process count and
+// the number of used physical frames after each round. Both should stay flat.
+// Built with -DKERNEL_BENCH_SPAWN.
+#define SPAWN_BENCH_ROUNDS 50
+#define SPAWN_BENCH_BATCH 8
+
+static void spawn_bench_run(void* arg) {
+    (void)arg;
+    cli();
+    for (uint32_t round = 0; round < SPAWN_BENCH_ROUNDS; round++) {
+        for (uint32_t i = 0; i < SPAWN_BENCH_BATCH; i++) {
+            if (!make_user_proc_with_message("[spawn] hello", USER_DEMO_EXIT, PROC_PRIORITY_NORMAL)) {
+                printf("spawn bench: create failed in round %u\n", round);
+                break;
+            }
+        }
+        int32_t status;
+        while (proc_wait(PROC_WAIT_ANY, &status) != PROC_WAIT_ANY);
+        printf("spawn bench: round %u: %u procs, %u frames used\n", round, nr_procs, pmm_used_frames());
+    }
+    sti();
+}
+
+static void kernel_spawn_bench(void) {
+    if (!kthread_create(spawn_bench_run, NULL, PROC_PRIORITY_NORMAL)) {
+        printf("spawn bench: failed to start\n");
+    }
+}
+#endif
+
+// --- Boot modules ---
+// Starts one process per multiboot module, each expected to be a static ELF32
+// executable (e.g. `module /boot/hello.elf` in grub.cfg).
+static void kernel_run_modules(multiboot_info_t* mbd) {
+    mbd = (multiboot_info_t*)((uint32_t)mbd + 0xC0000000);
+    if (!(mbd->flags & MULTIBOOT_INFO_MODS)) {
+        return;
+    }
+    multiboot_module_t* mods = (multiboot_module_t*)(mbd->mods_addr + 0xC0000000);
+    for (uint32_t i = 0; i < mbd->mods_count; i++) {
+        const char* name = mods[i].cmdline ? (const char*)(mods[i].cmdline + 0xC0000000) : "?";
+        proc_t* p = elf_load(mods[i].mod_start, mods[i].mod_end - mods[i].mod_start, PROC_PRIORITY_NORMAL);
+        if (!p) {
+            printf("module %u (%s): not loaded\n", i, name);
+            continue;
+        }
+        printf("module %u (%s): pid %u\n", i, name, p->pid);
+    }
 }
 
 #ifndef KERNEL_VERSION
@@ -290,19 +594,44 @@ void kmain(multiboot_info_t* mbd, uint32_t magic) {
 	printf("BrownieOS kernel version %s for %s\n\n", KERNEL_VERSION, KERNEL_ARCH);
 	printlogo();
 	kheap_init();
+	umm_init();
+	shm_init();
+	swap_init();
+	tsc_init();
+	fpu_init();
 	proc_init();
 	kernel_proc_init();
 	scheduler_init();
+	workqueue_init();
+	umm_promote_start();
 	isr_init();
 	syscall_init();
 	init_acpi();
 	parse_madt();
+	smp_init();
 	//init_apic();
+	timer_init();
 	pit_init(1000);
 	//init_hpet(10000);
 	
 	// Original single-process demo:
 	// kernel_process_test();
 	kernel_three_process_test();
-	kpause();
+	// Priority inheritance check, reported once the scheduler runs
+	kernel_mutex_pi_test();
+	kernel_run_modules(mbd);
+#ifdef KERNEL_BENCH_FAIR
+	// Fair-share accuracy benchmark
+	kernel_fair_share_bench();
+#endif
+#ifdef KERNEL_BENCH_EDF
+	// EDF reservations next to fair load
+	kernel_edf_demo();
+#endif
+#ifdef KERNEL_BENCH_SPAWN
+	// Process spawn/exit reclamation check
+	kernel_spawn_bench();
+#endif
+	// kmain's context becomes the idle task
+	scheduler_idle_loop();
 }
@@ -0,0 +1,245 @@
+#include <stddef.h>
+#include <stdbool.h>
+#include <core/rbtree.h>
+
+// Classic red-black tree (CLRS) with NULL leaves; NULL counts as black.
+
+static bool rb_is_red(const rb_node_t* node) {
+    return node != NULL && node->red;
+}
+
+static void rb_rotate_left(rb_root_t* root, rb_node_t* x) {
+    rb_node_t* y = x->right;
+    x->right = y->left;
+    if(y->left) {
+        y->left->parent = x;
+    }
+    y->parent = x->parent;
+    if(!x->parent) {
+        root->node = y;
+    } else if(x == x->parent->left) {
+        x->parent->left = y;
+    } else {
+        x->parent->right = y;
+    }
+    y->left = x;
+    x->parent = y;
+}
+
+static void rb_rotate_right(rb_root_t* root, rb_node_t* x) {
+    rb_node_t* y = x->left;
+    x->left = y->right;
+    if(y->right) {
+        y->right->parent = x;
+    }
+    y->parent = x->parent;
+    if(!x->parent) {
+        root->node = y;
+    } else if(x == x->parent->right) {
+        x->parent->right = y;
+    } else {
+        x->parent->left = y;
+    }
+    y->right = x;
+    x->parent = y;
+}
+
+void rb_insert(rb_root_t* root, rb_node_t* node, rb_less_t less) {
+    rb_node_t* parent = NULL;
+    rb_node_t** link = &root->node;
+    while(*link) {
+        parent = *link;
+        link = less(node, parent) ? &parent->left : &parent->right;
+    }
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->red = true;
+    *link = node;
+
+    rb_node_t* z = node;
+    while(rb_is_red(z->parent)) {
+        // a red parent is never the root, so the grandparent exists
+        rb_node_t* gp = z->parent->parent;
+        if(z->parent == gp->left) {
+            rb_node_t* uncle = gp->right;
+            if(rb_is_red(uncle)) {
+                z->parent->red = false;
+                uncle->red = false;
+                gp->red = true;
+                z = gp;
+                continue;
+            }
+            if(z == z->parent->right) {
+                z = z->parent;
+                rb_rotate_left(root, z);
+            }
+            z->parent->red = false;
+            gp->red = true;
+            rb_rotate_right(root, gp);
+        } else {
+            rb_node_t* uncle = gp->left;
+            if(rb_is_red(uncle)) {
+                z->parent->red = false;
+                uncle->red = false;
+                gp->red = true;
+                z = gp;
+                continue;
+            }
+            if(z == z->parent->left) {
+                z = z->parent;
+                rb_rotate_right(root, z);
+            }
+            z->parent->red = false;
+            gp->red = true;
+            rb_rotate_left(root, gp);
+        }
+    }
+    root->node->red = false;
+}
+
+// Replaces the subtree rooted at `u` with the one rooted at `v`.
+static void rb_transplant(rb_root_t* root, rb_node_t* u, rb_node_t* v) {
+    if(!u->parent) {
+        root->node = v;
+    } else if(u == u->parent->left) {
+        u->parent->left = v;
+    } else {
+        u->parent->right = v;
+    }
+    if(v) {
+        v->parent = u->parent;
+    }
+}
+
+// Restores the black height after removing a black node. `x` took its place
+// and may be NULL, so its parent is passed separately.
+static void rb_erase_fixup(rb_root_t* root, rb_node_t* x, rb_node_t* parent) {
+    while(x != root->node && !rb_is_red(x)) {
+        if(x == parent->left) {
+            rb_node_t* w = parent->right;
+            if(rb_is_red(w)) {
+                w->red = false;
+                parent->red = true;
+                rb_rotate_left(root, parent);
+                w = parent->right;
+            }
+            if(!rb_is_red(w->left) && !rb_is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if(!rb_is_red(w->right)) {
+                w->left->red = false;
+                w->red = true;
+                rb_rotate_right(root, w);
+                w = parent->right;
+            }
+            w->red = parent->red;
+            parent->red = false;
+            if(w->right) {
+                w->right->red = false;
+            }
+            rb_rotate_left(root, parent);
+            x = root->node;
+        } else {
+            rb_node_t* w = parent->left;
+            if(rb_is_red(w)) {
+                w->red = false;
+                parent->red = true;
+                rb_rotate_right(root, parent);
+                w = parent->left;
+            }
+            if(!rb_is_red(w->left) && !rb_is_red(w->right)) {
+                w->red = true;
+                x = parent;
+                parent = x->parent;
+                continue;
+            }
+            if(!rb_is_red(w->left)) {
+                w->right->red = false;
+                w->red = true;
+                rb_rotate_left(root, w);
+                w = parent->left;
+            }
+            w->red = parent->red;
+            parent->red = false;
+            if(w->left) {
+                w->left->red = false;
+            }
+            rb_rotate_right(root, parent);
+            x = root->node;
+        }
+    }
+    if(x) {
+        x->red = false;
+    }
+}
+
+void rb_erase(rb_root_t* root, rb_node_t* z) {
+    rb_node_t* x;
+    rb_node_t* parent;
+    bool removed_red = z->red;
+
+    if(!z->left) {
+        x = z->right;
+        parent = z->parent;
+        rb_transplant(root, z, z->right);
+    } else if(!z->right) {
+        x = z->left;
+        parent = z->parent;
+        rb_transplant(root, z, z->left);
+    } else {
+        // two children: the successor takes z's place and color
+        rb_node_t* y = z->right;
+        while(y->left) {
+            y = y->left;
+        }
+        removed_red = y->red;
+        x = y->right;
+        if(y->parent == z) {
+            parent = y;
+        } else {
+            parent = y->parent;
+            rb_transplant(root, y, y->right);
+            y->right = z->right;
+            y->right->parent = y;
+        }
+        rb_transplant(root, z, y);
+        y->left = z->left;
+        y->left->parent = y;
+        y->red = z->red;
+    }
+    if(!removed_red) {
+        rb_erase_fixup(root, x, parent);
+    }
+    z->parent = NULL;
+    z->left = NULL;
+    z->right = NULL;
+}
+
+rb_node_t* rb_first(const rb_root_t* root) {
+    rb_node_t* node = root->node;
+    if(!node) {
+        return NULL;
+    }
+    while(node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+rb_node_t* rb_next(const rb_node_t* node) {
+    if(node->right) {
+        node = node->right;
+        while(node->left) {
+            node = node->left;
+        }
+        return (rb_node_t*)node;
+    }
+    while(node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
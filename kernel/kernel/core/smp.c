@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <core/smp.h>
+#include <core/gdt.h>
+#include <core/idt.h>
+#include <core/apic.h>
+#include <core/madt.h>
+#include <core/common.h>
+#include <core/fpu.h>
+#include <drivers/tsc.h>
+#include <mm/kmm.h>
+#include <mm/vmm.h>
+#include <mm/paging.h>
+
+extern page_directory_t* kernel_directory;
+
+// Local APIC registers (byte offsets)
+#define LAPIC_ID (0x20)
+#define LAPIC_ICR_LOW (0x300)
+#define LAPIC_ICR_HIGH (0x310)
+// ICR: delivery status, set until the IPI has been accepted
+#define LAPIC_ICR_PENDING (1 << 12)
+// ICR: INIT (level triggered, assert) and STARTUP delivery modes
+#define LAPIC_ICR_INIT (0x00004500)
+#define LAPIC_ICR_STARTUP (0x00004600)
+
+// Offset of trampoline symbol `sym` within the copied page
+#define TRAMP_OFFSET(sym) ((uint32_t)&(sym) - (uint32_t)smp_trampoline_start)
+
+static cpu_t cpus[SMP_MAX_CPUS];
+static uint32_t nr_online = 1;
+static volatile uint32_t* lapic = NULL;
+// Per-CPU area of the AP being started, picked up by smp_ap_entry
+static cpu_t* volatile smp_booting = NULL;
+
+cpu_t* smp_cpu(uint32_t id) {
+    return &cpus[id];
+}
+
+cpu_t* this_cpu(void) {
+    cpu_t* cpu;
+    asm volatile("movl %%gs:0, %0" : "=r"(cpu));
+    return cpu;
+}
+
+uint32_t smp_num_online(void) {
+    return nr_online;
+}
+
+static uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static void lapic_write(uint32_t reg, uint32_t val) {
+    lapic[reg / 4] = val;
+}
+
+static void smp_delay_us(uint64_t us) {
+    uint64_t end = tsc_us() + us;
+    while(tsc_us() < end) {
+        asm volatile("pause");
+    }
+}
+
+// Sends IPI `icr` to the processor with local APIC ID `apic_id` and waits
+// until its APIC accepted it.
+static void lapic_send_ipi(uint32_t apic_id, uint32_t icr) {
+    lapic_write(LAPIC_ICR_HIGH, apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, icr);
+    while(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        asm volatile("pause");
+    }
+}
+
+// First kernel code run by an AP, on its own stack, still on the temporary
+// page directory.
+static __attribute__((noreturn)) void smp_ap_entry(void) {
+    cpu_t* cpu = smp_booting;
+    swap_dir(kernel_directory);
+    if(paging_pse_enabled()) {
+        enable_pse();
+    }
+    gdt_init_cpu(cpu);
+    idt_load();
+    // lazy switching relies on CR0.TS and the OSFXSR bits on every CPU
+    fpu_init_cpu();
+    cpu->online = true;
+    // nothing is scheduled on APs yet: stay halted with interrupts off
+    while(true) {
+        asm volatile("cli; hlt");
+    }
+}
+
+// Starts the AP of `cpu` through the trampoline copied to `tramp`. Returns
+// whether it came online in time; if not, it is parked with INIT.
+static bool smp_boot_ap(cpu_t* cpu, uint8_t* tramp) {
+    uint32_t stack = alloc_pages(PMM_FLAGS_DEFAULT, SMP_AP_STACK_PAGES);
+    if(!stack) {
+        return false;
+    }
+    cpu->kstack_top = KP2V(stack) + SMP_AP_STACK_PAGES * PAGE_SIZE;
+    *(uint32_t*)(tramp + TRAMP_OFFSET(smp_trampoline_stack)) = cpu->kstack_top;
+    smp_booting = cpu;
+
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT);
+    smp_delay_us(10000);
+    // the second SIPI is only for processors that missed the first one
+    for(uint32_t i = 0; i < 2 && !cpu->online; i++) {
+        lapic_send_ipi(cpu->apic_id, LAPIC_ICR_STARTUP | (SMP_TRAMPOLINE_ADDR >> 12));
+        smp_delay_us(200);
+    }
+    uint64_t deadline = tsc_us() + SMP_AP_TIMEOUT_US;
+    while(!cpu->online && tsc_us() < deadline) {
+        asm volatile("pause");
+    }
+    if(cpu->online) {
+        return true;
+    }
+    // Park it in wait-for-SIPI: a late start would run whatever the
+    // trampoline page holds once it is restored. Its stack is unused then.
+    lapic_send_ipi(cpu->apic_id, LAPIC_ICR_INIT);
+    cpu->online = false;
+    cpu->kstack_top = 0;
+    free_pages(PAGE_FRAME(stack), SMP_AP_STACK_PAGES);
+    return false;
+}
+
+void smp_init(void) {
+    cpu_t* bsp = &cpus[0];
+    lapic = (volatile uint32_t*)kmap(get_apic_base());
+    bsp->apic_id = lapic_read(LAPIC_ID) >> 24;
+    bsp->online = true;
+    uint8_t num_procs = get_num_procs();
+    if(num_procs <= 1) {
+        printf("smp: 1 processor\n");
+        return;
+    }
+
+    // Temporary page directory: the kernel half of kernel_directory plus the
+    // trampoline page at its physical address, so that the AP survives the
+    // instruction that turns paging on
+    uint32_t dir_phys = alloc_pages(PMM_FLAGS_DEFAULT, 2);
+    if(!dir_phys) {
+        printf("smp: out of memory\n");
+        return;
+    }
+    page_dir_entry_t* dir = (page_dir_entry_t*)KP2V(dir_phys);
+    page_table_t* table = (page_table_t*)KP2V(dir_phys + PAGE_SIZE);
+    memset(dir, 0, PAGE_SIZE);
+    memset(table, 0, PAGE_SIZE);
+    for(uint32_t i = KERN_START_TBL; i < 1024; i++) {
+        dir[i] = kernel_directory->page_dir_entries[i];
+    }
+    set_page(&table->pages[PAGE_TBL_IDX(SMP_TRAMPOLINE_ADDR)], PAGE_FRAME(SMP_TRAMPOLINE_ADDR), true, true, false);
+    dir[PAGE_DIR_IDX(SMP_TRAMPOLINE_ADDR)].frame = PAGE_FRAME(dir_phys + PAGE_SIZE);
+    dir[PAGE_DIR_IDX(SMP_TRAMPOLINE_ADDR)].rw = 1;
+    dir[PAGE_DIR_IDX(SMP_TRAMPOLINE_ADDR)].present = 1;
+
+    // the page may hold bootloader data (e.g. the multiboot information)
+    uint8_t* tramp = (uint8_t*)KP2V(SMP_TRAMPOLINE_ADDR);
+    uint8_t* saved = (uint8_t*)kmalloc(PAGE_SIZE);
+    if(saved == NULL) {
+        printf("smp: out of memory\n");
+        free_pages(PAGE_FRAME(dir_phys), 2);
+        return;
+    }
+    memcpy(saved, tramp, PAGE_SIZE);
+    memcpy(tramp, smp_trampoline_start, smp_trampoline_end - smp_trampoline_start);
+    *(uint32_t*)(tramp + TRAMP_OFFSET(smp_trampoline_cr3)) = dir_phys;
+    *(uint32_t*)(tramp + TRAMP_OFFSET(smp_trampoline_entry)) = (uint32_t)smp_ap_entry;
+
+    uint8_t* lapic_ids = get_lapic_ids();
+    uint32_t next = 1;
+    for(uint32_t i = 0; i < num_procs; i++) {
+        if(lapic_ids[i] == bsp->apic_id) {
+            continue;
+        }
+        if(next >= SMP_MAX_CPUS) {
+            printf("smp: only %u processors supported\n", SMP_MAX_CPUS);
+            break;
+        }
+        cpu_t* cpu = &cpus[next];
+        cpu->id = next;
+        cpu->apic_id = lapic_ids[i];
+        if(smp_boot_ap(cpu, tramp)) {
+            nr_online++;
+            next++;
+        } else {
+            // parked for good; its slot goes to the next processor
+            printf("smp: processor with APIC id %u did not start\n", cpu->apic_id);
+        }
+    }
+
+    memcpy(tramp, saved, PAGE_SIZE);
+    kfree(saved);
+    free_pages(PAGE_FRAME(dir_phys), 2);
+    printf("smp: %u of %u processors online\n", nr_online, num_procs);
+}
@@ -0,0 +1,69 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <core/softirq.h>
+#include <core/common.h>
+#include <drivers/tsc.h>
+#include <proc/scheduler.h>
+
+static softirq_handler_t softirq_vec[SOFTIRQ_NR];
+static volatile uint32_t softirq_bits = 0;
+static softirq_stats_t softirq_stats[SOFTIRQ_NR];
+
+static const char* const softirq_names[SOFTIRQ_NR] = {
+    "timer",
+};
+
+int softirq_register(uint32_t nr, softirq_handler_t handler) {
+    if(nr >= SOFTIRQ_NR || handler == NULL || softirq_vec[nr] != NULL) {
+        return -1;
+    }
+    softirq_vec[nr] = handler;
+    return 0;
+}
+
+void raise_softirq(uint32_t nr) {
+    uint32_t flags = irq_save();
+    softirq_bits |= 1u << nr;
+    irq_restore(flags);
+}
+
+bool softirq_pending(void) {
+    return softirq_bits != 0;
+}
+
+void do_softirq(void) {
+    if(preempt_count || !softirq_bits) {
+        return;
+    }
+    // keeps nested IRQs from running a pass or switching tasks under us
+    preempt_count++;
+    for(uint32_t pass = 0; softirq_bits && pass < SOFTIRQ_MAX_RESTART; pass++) {
+        uint32_t pending = softirq_bits;
+        softirq_bits = 0;
+        sti();
+        for(uint32_t nr = 0; nr < SOFTIRQ_NR; nr++) {
+            if(!(pending & (1u << nr)) || softirq_vec[nr] == NULL) {
+                continue;
+            }
+            uint64_t start = rdtsc();
+            softirq_vec[nr]();
+            uint64_t us = tsc_cycles_to_us(rdtsc() - start);
+            softirq_stats[nr].runs++;
+            softirq_stats[nr].total_us += us;
+            if(us > softirq_stats[nr].max_us) {
+                softirq_stats[nr].max_us = us;
+            }
+        }
+        cli();
+    }
+    preempt_count--;
+}
+
+void softirq_print_stats(void) {
+    printf("softirq (runs / total us / max us):\n");
+    for(uint32_t nr = 0; nr < SOFTIRQ_NR; nr++) {
+        printf("  %s: %llu / %llu / %llu\n", softirq_names[nr], softirq_stats[nr].runs,
+            softirq_stats[nr].total_us, softirq_stats[nr].max_us);
+    }
+}
@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <core/spinlock.h>
+#include <core/common.h>
+#include <proc/scheduler.h>
+
+// Registered lock statistics, in registration order
+static lock_stats_t* lock_stats_head = NULL;
+static lock_stats_t* lock_stats_tail = NULL;
+// Guards the registration list; anonymous itself
+static spinlock_t lock_stats_lock;
+
+// Atomically hands out the next ticket of `lock`.
+static uint16_t spin_take_ticket(spinlock_t* lock) {
+    uint16_t ticket = 1;
+    asm volatile("lock xaddw %0, %1" : "+r"(ticket), "+m"(lock->next) : : "memory");
+    return ticket;
+}
+
+void spin_lock_init(spinlock_t* lock, const char* name) {
+    lock->owner = 0;
+    lock->next = 0;
+#if LOCK_STATS
+    lock_stats_register(&lock->stats, name);
+#else
+    (void)name;
+#endif
+}
+
+void spin_lock(spinlock_t* lock) {
+    preempt_disable();
+    uint16_t ticket = spin_take_ticket(lock);
+    if(lock->owner == ticket) {
+#if LOCK_STATS
+        lock_stats_account(&lock->stats, false, 0);
+#endif
+        return;
+    }
+#if LOCK_STATS
+    uint64_t start = rdtsc();
+#endif
+    while(lock->owner != ticket) {
+        asm volatile("pause" : : : "memory");
+    }
+#if LOCK_STATS
+    lock_stats_account(&lock->stats, true, rdtsc() - start);
+#endif
+}
+
+bool spin_trylock(spinlock_t* lock) {
+    preempt_disable();
+    uint16_t owner = lock->owner;
+    // free means both halves equal; take a ticket only in that state
+    uint32_t expected = ((uint32_t)owner << 16) | owner;
+    uint32_t desired = expected + (1u << 16);
+    uint32_t prev;
+    // both halves at once, through their address
+    asm volatile("lock cmpxchgl %2, (%1)"
+        : "=a"(prev)
+        : "r"(&lock->owner), "r"(desired), "0"(expected)
+        : "memory");
+    if(prev != expected) {
+        preempt_enable();
+        return false;
+    }
+#if LOCK_STATS
+    lock_stats_account(&lock->stats, false, 0);
+#endif
+    return true;
+}
+
+void spin_unlock(spinlock_t* lock) {
+    // x86 does not reorder stores, so a compiler barrier is enough to keep the
+    // critical section ahead of the release
+    asm volatile("" : : : "memory");
+    lock->owner = (uint16_t)(lock->owner + 1);
+    preempt_enable();
+}
+
+uint32_t spin_lock_irqsave(spinlock_t* lock) {
+    uint32_t flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+void spin_unlock_irqrestore(spinlock_t* lock, uint32_t flags) {
+    // keep preemption off until interrupts are back, so that a reschedule
+    // requested meanwhile is taken by preempt_enable
+    asm volatile("" : : : "memory");
+    lock->owner = (uint16_t)(lock->owner + 1);
+    irq_restore(flags);
+    preempt_enable();
+}
+
+bool spin_is_locked(const spinlock_t* lock) {
+    return lock->owner != lock->next;
+}
+
+void lock_stats_account(lock_stats_t* stats, bool contended, uint64_t wait_cycles) {
+    stats->acquisitions++;
+    if(!contended) {
+        return;
+    }
+    stats->contended++;
+    stats->wait_cycles += wait_cycles;
+    if(wait_cycles > stats->max_wait_cycles) {
+        stats->max_wait_cycles = wait_cycles;
+    }
+}
+
+void lock_stats_register(lock_stats_t* stats, const char* name) {
+    stats->name = name;
+    stats->acquisitions = 0;
+    stats->contended = 0;
+    stats->wait_cycles = 0;
+    stats->max_wait_cycles = 0;
+    stats->next = NULL;
+    if(name == NULL) {
+        return;
+    }
+    uint32_t flags = spin_lock_irqsave(&lock_stats_lock);
+    if(lock_stats_tail) {
+        lock_stats_tail->next = stats;
+    } else {
+        lock_stats_head = stats;
+    }
+    lock_stats_tail = stats;
+    spin_unlock_irqrestore(&lock_stats_lock, flags);
+}
+
+void lock_print_stats(void) {
+#if LOCK_STATS
+    printf("locks (name: acquired / contended / wait cycles total / max):\n");
+    uint32_t flags = spin_lock_irqsave(&lock_stats_lock);
+    for(lock_stats_t* s = lock_stats_head; s; s = s->next) {
+        printf("  %s: %llu / %llu / %llu / %llu\n", s->name, s->acquisitions, s->contended,
+            s->wait_cycles, s->max_wait_cycles);
+    }
+    spin_unlock_irqrestore(&lock_stats_lock, flags);
+#else
+    printf("locks: statistics disabled (LOCK_STATS=0)\n");
+#endif
+}
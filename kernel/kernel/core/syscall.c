@@ -7,72 +7,15 @@
 #include <core/syscall.h>
 #include <core/isr.h>
 #include <proc/proc.h>
-#include <mm/paging.h>
+#include <core/uaccess.h>
+#include <mm/umm.h>
+#include <mm/shm.h>
+#include <proc/scheduler.h>
+#include <core/timer.h>
+#include <proc/futex.h>
 
 syscall_handler_t syscall_table[SYSCALL_MAX];
 
-bool user_addr_accessible(const proc_t* proc, uint32_t addr) {
-    if(proc == NULL || proc->page_directory == NULL) {
-        return false;
-    }
-    if(addr >= (uint32_t)PAGE_IDX_VADDR((uint32_t)KERN_START_TBL, 0, 0)) {
-        return false;
-    }
-
-    page_directory_t* dir = proc->page_directory;
-    uint32_t pd_idx = PAGE_DIR_IDX(addr);
-    uint32_t pt_idx = PAGE_TBL_IDX(addr);
-
-    page_dir_entry_t entry = dir->page_dir_entries[pd_idx];
-    if(!entry.present || !entry.user) {
-        return false;
-    }
-
-    page_table_t* table = dir->tables[pd_idx];
-    if(table == NULL) {
-        return false;
-    }
-
-    page_t page = table->pages[pt_idx];
-    if(!page.present || !page.user) {
-        return false;
-    }
-
-    return true;
-}
-
-static bool copy_user_string(proc_t* proc, char* dest, size_t dest_len, const char* src, uint32_t user_len) {
-    if(dest == NULL || dest_len == 0 || src == NULL || proc == NULL) {
-        return false;
-    }
-
-    size_t limit = user_len;
-    if(limit >= dest_len) {
-        limit = dest_len - 1;
-    }
-    if(limit == 0) {
-        dest[0] = '\0';
-        return true;
-    }
-
-    size_t copied = 0;
-    while(copied < limit) {
-        uint32_t addr = (uint32_t)src + (uint32_t)copied;
-        if(!user_addr_accessible(proc, addr)) {
-            return false;
-        }
-
-        char c = *((const volatile char*)addr);
-        dest[copied++] = c;
-        if(c == '\0') {
-            return true;
-        }
-    }
-
-    dest[copied] = '\0';
-    return true;
-}
-
 int syscall_register(uint32_t num, syscall_handler_t handler) {
     if(num >= SYSCALL_MAX || handler == NULL) {
         return -1;
@@ -92,6 +35,74 @@ void syscall_init(void) {
     if(rc != 0) {
         printf("syscall_init: failed to register SYS_PRINT_STRING (%d)\n", rc);
     }
+    rc = syscall_register(SYS_BRK, sys_brk);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_BRK (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SBRK, sys_sbrk);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SBRK (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SHM_CREATE, sys_shm_create);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SHM_CREATE (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SHM_ATTACH, sys_shm_attach);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SHM_ATTACH (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SHM_DETACH, sys_shm_detach);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SHM_DETACH (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SHM_DESTROY, sys_shm_destroy);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SHM_DESTROY (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SCHED_SETDEADLINE, sys_sched_setdeadline);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SCHED_SETDEADLINE (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SCHED_DL_STATS, sys_sched_dl_stats);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SCHED_DL_STATS (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SLEEP, sys_sleep);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SLEEP (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_NANOSLEEP, sys_nanosleep);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_NANOSLEEP (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SCHED_YIELD, sys_sched_yield);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SCHED_YIELD (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_EXIT, sys_exit);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_EXIT (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_WAITPID, sys_waitpid);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_WAITPID (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SCHED_STATS, sys_sched_stats);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SCHED_STATS (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SCHED_PROC_STATS, sys_sched_proc_stats);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SCHED_PROC_STATS (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_FUTEX, sys_futex);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_FUTEX (%d)\n", rc);
+    }
+    rc = syscall_register(SYS_SCHED_SETPOLICY, sys_sched_setpolicy);
+    if(rc != 0) {
+        printf("syscall_init: failed to register SYS_SCHED_SETPOLICY (%d)\n", rc);
+    }
 }
 
 void syscall_dispatch(int_regs_t* regs) {
@@ -131,12 +142,314 @@ void sys_print_string(int_regs_t* regs) {
     }
 
     char buffer[SYS_PRINT_STRING_MAX_LEN];
-    if(!copy_user_string(current_proc, buffer, sizeof(buffer), user_buf, user_len)) {
+    size_t limit = (user_len < sizeof(buffer) - 1) ? user_len : sizeof(buffer) - 1;
+    int32_t len = strncpy_from_user(buffer, user_buf, limit);
+    if(len < 0) {
         regs->eax = (uint32_t)SYSCALL_EFAULT;
         return;
     }
+    buffer[len] = '\0';
 
     //printf("[%u] %s\n", current_proc->pid, buffer);
     printf("%s\n", buffer);
     regs->eax = (uint32_t)SYSCALL_SUCCESS;
 }
+
+void sys_brk(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL || current_proc->heap_start == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+
+    uint32_t new_brk = regs->ebx;
+    // brk(0) and failed moves both report the current break
+    if(new_brk != 0) {
+        umm_set_brk(current_proc, new_brk);
+    }
+    regs->eax = (uint32_t)current_proc->brk;
+}
+
+void sys_sbrk(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL || current_proc->heap_start == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+
+    uint32_t old_brk = (uint32_t)current_proc->brk;
+    int32_t increment = (int32_t)regs->ebx;
+    uint32_t new_brk = old_brk + (uint32_t)increment;
+    // reject wrap-around in either direction before umm sees the value
+    if((increment > 0 && new_brk < old_brk) || (increment < 0 && new_brk > old_brk)) {
+        regs->eax = (uint32_t)SYSCALL_ENOMEM;
+        return;
+    }
+    if(umm_set_brk(current_proc, new_brk) != 0) {
+        regs->eax = (uint32_t)SYSCALL_ENOMEM;
+        return;
+    }
+    regs->eax = old_brk;
+}
+
+void sys_shm_create(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+
+    const char* user_name = (const char*)regs->ebx;
+    if(user_name == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    char name[SHM_NAME_MAX];
+    int32_t len = strncpy_from_user(name, user_name, sizeof(name) - 1);
+    if(len < 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    name[len] = '\0';
+    regs->eax = (uint32_t)shm_create(name, regs->ecx);
+}
+
+void sys_shm_attach(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    uint32_t vaddr = shm_attach(current_proc, regs->ebx);
+    regs->eax = vaddr ? vaddr : (uint32_t)SYSCALL_EINVAL;
+}
+
+void sys_shm_detach(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(shm_detach(current_proc, regs->ebx) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_shm_destroy(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(shm_destroy(regs->ebx) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_sched_setdeadline(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    if(regs->ebx == 0 && regs->ecx == 0 && regs->edx == 0) {
+        scheduler_clear_deadline(current_proc);
+        regs->eax = (uint32_t)SYSCALL_SUCCESS;
+        return;
+    }
+    int rc = scheduler_set_deadline(current_proc, regs->ebx, regs->ecx, regs->edx);
+    if(rc == -1) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    if(rc != 0) {
+        regs->eax = (uint32_t)SYSCALL_EBUSY;
+        return;
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_sched_dl_stats(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    sched_dl_stats_t stats = {
+        .jobs = current_proc->dl_jobs,
+        .misses = current_proc->dl_misses,
+        .overruns = current_proc->dl_overruns,
+        .reserved = 0,
+    };
+    if(copy_to_user((void*)regs->ebx, &stats, sizeof(stats)) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_sleep(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    timer_sleep_us((uint64_t)regs->ebx * 1000000);
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_nanosleep(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    sys_timespec_t req;
+    if(copy_from_user(&req, (const void*)regs->ebx, sizeof(req)) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    if(req.tv_nsec >= 1000000000u) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    // round up: never sleep less than asked
+    timer_sleep_us((uint64_t)req.tv_sec * 1000000 + (req.tv_nsec + 999) / 1000);
+    if(regs->ecx != 0) {
+        sys_timespec_t rem = { 0, 0 };
+        if(copy_to_user((void*)regs->ecx, &rem, sizeof(rem)) != 0) {
+            regs->eax = (uint32_t)SYSCALL_EFAULT;
+            return;
+        }
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_sched_yield(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    sched_yield();
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_exit(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    proc_exit((int32_t)regs->ebx);
+}
+
+void sys_waitpid(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    int32_t status = 0;
+    // check the status pointer first: the zombie is gone once reaped
+    if(regs->ecx != 0 && copy_to_user((void*)regs->ecx, &status, sizeof(status)) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    pid_t pid = proc_wait((pid_t)regs->ebx, &status);
+    if(pid == PROC_WAIT_ANY) {
+        regs->eax = (uint32_t)SYSCALL_ECHILD;
+        return;
+    }
+    if(regs->ecx != 0 && copy_to_user((void*)regs->ecx, &status, sizeof(status)) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    regs->eax = pid;
+}
+
+void sys_sched_stats(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(regs->ebx == 0) {
+        sched_print_stats();
+        regs->eax = (uint32_t)SYSCALL_SUCCESS;
+        return;
+    }
+    sched_stats_t stats;
+    sched_get_stats(&stats);
+    if(copy_to_user((void*)regs->ebx, &stats, sizeof(stats)) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_sched_proc_stats(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    proc_t* p = (regs->ebx == (uint32_t)-1) ? current_proc : proc_lookup((pid_t)regs->ebx);
+    if(p == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    sched_proc_stats_t stats = {
+        .run_time = p->sum_exec_runtime,
+        .wait_time = p->wait_sum,
+        .max_wait = p->wait_max,
+        .voluntary_switches = p->nvcsw,
+        .involuntary_switches = p->nivcsw,
+    };
+    if(copy_to_user((void*)regs->ecx, &stats, sizeof(stats)) != 0) {
+        regs->eax = (uint32_t)SYSCALL_EFAULT;
+        return;
+    }
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
+
+void sys_futex(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    int32_t rc;
+    switch(regs->ecx) {
+        case FUTEX_WAIT:
+            rc = futex_wait(regs->ebx, regs->edx, regs->esi);
+            break;
+        case FUTEX_WAKE:
+            rc = futex_wake(regs->ebx, regs->edx);
+            break;
+        default:
+            rc = SYSCALL_EINVAL;
+            break;
+    }
+    regs->eax = (uint32_t)rc;
+}
+
+void sys_sched_setpolicy(int_regs_t* regs) {
+    if(regs == NULL) {
+        return;
+    }
+    if(current_proc == NULL) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    if(regs->ebx != SCHED_POLICY_FAIR && regs->ebx != SCHED_POLICY_RR) {
+        regs->eax = (uint32_t)SYSCALL_EINVAL;
+        return;
+    }
+    scheduler_set_policy(current_proc, (sched_policy_t)regs->ebx);
+    regs->eax = (uint32_t)SYSCALL_SUCCESS;
+}
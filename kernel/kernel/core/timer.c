@@ -0,0 +1,214 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <core/timer.h>
+#include <core/softirq.h>
+#include <core/common.h>
+#include <drivers/clockevent.h>
+#include <proc/proc.h>
+#include <proc/scheduler.h>
+
+#define TIMER_TVR_MASK (TIMER_TVR_SIZE - 1)
+#define TIMER_TVN_MASK (TIMER_TVN_SIZE - 1)
+// Bit position of the slot index of upper level `l`
+#define TIMER_LEVEL_SHIFT(l) (TIMER_TVR_BITS + (l) * TIMER_TVN_BITS)
+
+static ktimer_t* tv1[TIMER_TVR_SIZE];
+static ktimer_t* tvn[TIMER_TVN_LEVELS][TIMER_TVN_SIZE];
+// Next tick to process
+static uint64_t timer_jiffies = 0;
+static uint32_t nr_pending = 0;
+
+static void timer_link(ktimer_t** head, ktimer_t* t) {
+    t->next = *head;
+    if (t->next) {
+        t->next->pprev = &t->next;
+    }
+    *head = t;
+    t->pprev = head;
+}
+
+static void timer_unlink(ktimer_t* t) {
+    *t->pprev = t->next;
+    if (t->next) {
+        t->next->pprev = t->pprev;
+    }
+    t->next = NULL;
+    t->pprev = NULL;
+}
+
+// Files `t` in the slot matching its distance from timer_jiffies.
+static void timer_enqueue(ktimer_t* t) {
+    if (t->expires < timer_jiffies) {
+        // overdue: the slot processed next
+        timer_link(&tv1[timer_jiffies & TIMER_TVR_MASK], t);
+        return;
+    }
+    uint64_t delta = t->expires - timer_jiffies;
+    if (delta < TIMER_TVR_SIZE) {
+        timer_link(&tv1[t->expires & TIMER_TVR_MASK], t);
+        return;
+    }
+    if (delta > TIMER_MAX_TICKS) {
+        t->expires = timer_jiffies + TIMER_MAX_TICKS;
+    }
+    uint32_t level = 0;
+    while (level < TIMER_TVN_LEVELS - 1 && delta >= (1ull << TIMER_LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+    uint32_t idx = (t->expires >> TIMER_LEVEL_SHIFT(level)) & TIMER_TVN_MASK;
+    timer_link(&tvn[level][idx], t);
+}
+
+// Re-files every timer of upper level slot `idx` one or more levels down.
+// Returns `idx` so the caller can tell whether that level wrapped as well.
+static uint32_t timer_cascade(uint32_t level, uint32_t idx) {
+    ktimer_t* work = tvn[level][idx];
+    tvn[level][idx] = NULL;
+    if (work) {
+        work->pprev = &work;
+    }
+    while (work) {
+        ktimer_t* t = work;
+        timer_unlink(t);
+        timer_enqueue(t);
+    }
+    return idx;
+}
+
+// SOFTIRQ_TIMER handler. Timer callbacks keep running with interrupts
+// disabled, as they may wake tasks.
+static void timer_softirq(void) {
+    cli();
+    timer_run();
+    sti();
+}
+
+void timer_init(void) {
+    for (uint32_t i = 0; i < TIMER_TVR_SIZE; i++) {
+        tv1[i] = NULL;
+    }
+    for (uint32_t l = 0; l < TIMER_TVN_LEVELS; l++) {
+        for (uint32_t i = 0; i < TIMER_TVN_SIZE; i++) {
+            tvn[l][i] = NULL;
+        }
+    }
+    timer_jiffies = tick_count;
+    nr_pending = 0;
+    if (softirq_register(SOFTIRQ_TIMER, timer_softirq) != 0) {
+        printf("timer: failed to register the timer softirq\n");
+    }
+}
+
+void timer_setup(ktimer_t* t, timer_fn_t fn, void* arg) {
+    t->next = NULL;
+    t->pprev = NULL;
+    t->expires = 0;
+    t->fn = fn;
+    t->arg = arg;
+}
+
+void timer_add(ktimer_t* t, uint64_t expires) {
+    timer_del(t);
+    t->expires = expires;
+    timer_enqueue(t);
+    nr_pending++;
+}
+
+bool timer_del(ktimer_t* t) {
+    if (!t->pprev) {
+        return false;
+    }
+    timer_unlink(t);
+    nr_pending--;
+    return true;
+}
+
+bool timer_pending(const ktimer_t* t) {
+    return t->pprev != NULL;
+}
+
+void timer_tick(void) {
+    if (nr_pending == 0) {
+        timer_jiffies = tick_count + 1;
+        return;
+    }
+    raise_softirq(SOFTIRQ_TIMER);
+}
+
+void timer_run(void) {
+    uint64_t now = tick_count;
+    if (nr_pending == 0) {
+        // nothing to cascade; slots are absolute, so skip ahead
+        timer_jiffies = now + 1;
+        return;
+    }
+    while (timer_jiffies <= now) {
+        uint32_t idx = timer_jiffies & TIMER_TVR_MASK;
+        if (idx == 0) {
+            for (uint32_t l = 0; l < TIMER_TVN_LEVELS; l++) {
+                if (timer_cascade(l, (timer_jiffies >> TIMER_LEVEL_SHIFT(l)) & TIMER_TVN_MASK) != 0) {
+                    break;
+                }
+            }
+        }
+        ktimer_t* work = tv1[idx];
+        tv1[idx] = NULL;
+        if (work) {
+            work->pprev = &work;
+        }
+        timer_jiffies++;
+        // callbacks may add or delete timers, including ones on `work`
+        while (work) {
+            ktimer_t* t = work;
+            timer_unlink(t);
+            nr_pending--;
+            t->fn(t->arg);
+        }
+    }
+}
+
+uint64_t timer_next_expiry(void) {
+    if (nr_pending == 0) {
+        return UINT64_MAX;
+    }
+    uint64_t next = UINT64_MAX;
+    // level 0 slots hold exactly one tick each: the first busy one is exact
+    for (uint32_t i = 0; i < TIMER_TVR_SIZE; i++) {
+        if (tv1[(timer_jiffies + i) & TIMER_TVR_MASK]) {
+            next = timer_jiffies + i;
+            break;
+        }
+    }
+    // upper levels hold ranges that may end before level 0's first timer
+    for (uint32_t l = 0; l < TIMER_TVN_LEVELS; l++) {
+        for (uint32_t i = 0; i < TIMER_TVN_SIZE; i++) {
+            for (ktimer_t* t = tvn[l][i]; t; t = t->next) {
+                if (t->expires < next) {
+                    next = t->expires;
+                }
+            }
+        }
+    }
+    return next;
+}
+
+uint64_t timer_us_to_ticks(uint64_t us) {
+    uint32_t period = tick_period_us();
+    return (us + period - 1) / period;
+}
+
+static void timer_wake_proc(void* arg) {
+    scheduler_wake((proc_t*)arg);
+}
+
+void timer_sleep_us(uint64_t us) {
+    ktimer_t t;
+    timer_setup(&t, timer_wake_proc, current_proc);
+    // the current tick is already partly over: one more guarantees `us`
+    timer_add(&t, tick_count + timer_us_to_ticks(us) + 1);
+    while (timer_pending(&t)) {
+        scheduler_block();
+    }
+}
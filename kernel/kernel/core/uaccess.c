@@ -0,0 +1,48 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <core/uaccess.h>
+#include <core/syscall.h>
+
+// Bounds of the `__ex_table` section (linker.ld)
+extern exception_table_entry_t _ex_table_start[];
+extern exception_table_entry_t _ex_table_end[];
+
+bool access_ok(const void* addr, size_t size) {
+    uint32_t start = (uint32_t)addr;
+    return start < USER_SPACE_END && size <= USER_SPACE_END - start;
+}
+
+size_t copy_from_user(void* dst, const void* user_src, size_t n) {
+    if(!access_ok(user_src, n)) {
+        return n;
+    }
+    return __copy_user(dst, user_src, n);
+}
+
+size_t copy_to_user(void* user_dst, const void* src, size_t n) {
+    if(!access_ok(user_dst, n)) {
+        return n;
+    }
+    return __copy_user(user_dst, src, n);
+}
+
+int32_t strncpy_from_user(char* dst, const char* user_src, size_t n) {
+    if(user_src == NULL || (uint32_t)user_src >= USER_SPACE_END) {
+        return SYSCALL_EFAULT;
+    }
+    // the string may end before n: only clip the scan at the kernel boundary
+    if(n > USER_SPACE_END - (uint32_t)user_src) {
+        n = USER_SPACE_END - (uint32_t)user_src;
+    }
+    return __strncpy_user(dst, user_src, n);
+}
+
+uint32_t search_exception_table(uint32_t eip) {
+    for(exception_table_entry_t* entry = _ex_table_start; entry < _ex_table_end; entry++) {
+        if(entry->insn == eip) {
+            return entry->fixup;
+        }
+    }
+    return 0;
+}
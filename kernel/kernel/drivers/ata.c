@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <drivers/ata.h>
+#include <core/common.h>
+
+static uint32_t sector_count = 0;
+
+// 400ns delay: each read of the alternate status register takes ~100ns
+static void ata_delay(void) {
+    for(int i = 0; i < 4; i++) {
+        inb(ATA_PRIMARY_CTRL);
+    }
+}
+
+// Spins until BSY clears, then until DRQ is set when `drq` is true. Returns -1
+// if the drive reports an error or a device fault.
+static int ata_poll(bool drq) {
+    ata_delay();
+    uint8_t status;
+    while((status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS)) & ATA_SR_BSY);
+    if(status & (ATA_SR_ERR | ATA_SR_DF)) {
+        return -1;
+    }
+    if(drq) {
+        while(!((status = inb(ATA_PRIMARY_IO + ATA_REG_STATUS)) & ATA_SR_DRQ)) {
+            if(status & (ATA_SR_ERR | ATA_SR_DF)) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Selects the master drive in LBA mode and loads the 28-bit address/count
+static void ata_setup(uint32_t lba, uint8_t count, uint8_t cmd) {
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, 0xE0 | ((lba >> 24) & 0x0F));
+    ata_delay();
+    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT, count);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, (uint8_t)(lba & 0xFF));
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, (uint8_t)((lba >> 8) & 0xFF));
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, (uint8_t)((lba >> 16) & 0xFF));
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, cmd);
+}
+
+bool ata_init(void) {
+    // floating bus: no controller at all
+    if(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0xFF) {
+        return false;
+    }
+    // nIEN: we poll, so keep IRQ14 quiet
+    outb(ATA_PRIMARY_CTRL, 0x02);
+
+    outb(ATA_PRIMARY_IO + ATA_REG_DRIVE, 0xA0);
+    ata_delay();
+    outb(ATA_PRIMARY_IO + ATA_REG_SECCOUNT, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA0, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA1, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_LBA2, 0);
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_IDENTIFY);
+    if(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) == 0) {
+        return false;
+    }
+    while(inb(ATA_PRIMARY_IO + ATA_REG_STATUS) & ATA_SR_BSY);
+    // ATAPI/SATA signatures leave non-zero values in LBA1/LBA2
+    if(inb(ATA_PRIMARY_IO + ATA_REG_LBA1) != 0 || inb(ATA_PRIMARY_IO + ATA_REG_LBA2) != 0) {
+        return false;
+    }
+    if(ata_poll(true) != 0) {
+        return false;
+    }
+
+    uint16_t identify[256];
+    for(int i = 0; i < 256; i++) {
+        identify[i] = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+    }
+    // words 60-61: total number of user addressable sectors (LBA28)
+    sector_count = (uint32_t)identify[60] | ((uint32_t)identify[61] << 16);
+    printf("ATA: primary master, %u sectors\n", sector_count);
+    return sector_count != 0;
+}
+
+uint32_t ata_sector_count(void) {
+    return sector_count;
+}
+
+int ata_read(uint32_t lba, uint32_t count, void* buf) {
+    uint16_t* ptr = (uint16_t*)buf;
+    while(count > 0) {
+        uint8_t chunk = (count > 255) ? 255 : (uint8_t)count;
+        ata_setup(lba, chunk, ATA_CMD_READ_PIO);
+        for(uint8_t s = 0; s < chunk; s++) {
+            if(ata_poll(true) != 0) {
+                return -1;
+            }
+            for(int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+                *ptr++ = inw(ATA_PRIMARY_IO + ATA_REG_DATA);
+            }
+        }
+        lba += chunk;
+        count -= chunk;
+    }
+    return 0;
+}
+
+int ata_write(uint32_t lba, uint32_t count, const void* buf) {
+    const uint16_t* ptr = (const uint16_t*)buf;
+    while(count > 0) {
+        uint8_t chunk = (count > 255) ? 255 : (uint8_t)count;
+        ata_setup(lba, chunk, ATA_CMD_WRITE_PIO);
+        for(uint8_t s = 0; s < chunk; s++) {
+            if(ata_poll(true) != 0) {
+                return -1;
+            }
+            for(int i = 0; i < ATA_SECTOR_SIZE / 2; i++) {
+                outw(ATA_PRIMARY_IO + ATA_REG_DATA, *ptr++);
+            }
+        }
+        lba += chunk;
+        count -= chunk;
+    }
+    outb(ATA_PRIMARY_IO + ATA_REG_COMMAND, ATA_CMD_CACHE_FLUSH);
+    return ata_poll(false);
+}
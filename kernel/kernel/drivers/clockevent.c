@@ -0,0 +1,127 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <drivers/clockevent.h>
+#include <core/timer.h>
+#include <proc/scheduler.h>
+#include <mm/umm.h>
+
+volatile uint64_t tick_count = 0;
+
+static const clock_event_device_t* tick_dev = NULL;
+static uint32_t tick_hz = 0;
+static uint32_t tick_period = 0;    // microseconds
+static uint64_t last_tick_us = 0;   // sched_clock time accounted up to
+static bool tick_stopped = false;
+static uint64_t nohz_start_us = 0;
+
+static struct {
+    uint64_t start_us;
+    uint64_t irqs;
+    uint64_t nohz_entries;
+    uint64_t nohz_us;
+} tick_stats;
+
+void clockevent_register(const clock_event_device_t* dev) {
+    if(dev == NULL || (tick_dev != NULL && tick_dev->rating >= dev->rating)) {
+        return;
+    }
+    const clock_event_device_t* old = tick_dev;
+    tick_dev = dev;
+    printf("clockevent: using %s\n", dev->name);
+    if(old == NULL || tick_hz == 0) {
+        return;
+    }
+    old->shutdown();
+    // a stopped tick is restarted by the next idle exit
+    tick_stopped = false;
+    dev->set_periodic(tick_hz);
+}
+
+uint32_t tick_period_us(void) {
+    return tick_period;
+}
+
+// Periodic work done once per tick (or once per wakeup while tickless).
+static void tick_handle(uint64_t prev_count) {
+    if((tick_count / UMM_PROMOTE_INTERVAL) != (prev_count / UMM_PROMOTE_INTERVAL)) {
+        umm_promote_kick();
+    }
+    timer_tick();
+    scheduler_tick();
+}
+
+void clockevent_handle_interrupt(void) {
+    uint64_t prev_count = tick_count;
+    tick_stats.irqs++;
+    if(tick_stopped) {
+        // the one-shot expired: resume ticking; the idle loop stops it again
+        tick_nohz_idle_exit();
+    } else {
+        tick_count++;
+        last_tick_us = sched_clock();
+    }
+    tick_handle(prev_count);
+}
+
+void tick_init(uint32_t hz) {
+    if(tick_dev == NULL || hz == 0) {
+        printf("tick: no clockevent device\n");
+        return;
+    }
+    tick_hz = hz;
+    tick_period = 1000000 / hz;
+    last_tick_us = sched_clock();
+    tick_stats.start_us = last_tick_us;
+    tick_dev->set_periodic(hz);
+}
+
+void tick_nohz_idle_enter(void) {
+    if(tick_stopped || tick_dev == NULL || !(tick_dev->features & CLOCK_EVT_FEAT_ONESHOT)) {
+        return;
+    }
+    if(!scheduler_idle()) {
+        return;
+    }
+    uint64_t now = sched_clock();
+    uint64_t next = scheduler_next_event();
+    uint64_t timer_tick = timer_next_expiry();
+    if(timer_tick != UINT64_MAX) {
+        uint64_t timer_us = (timer_tick > tick_count)
+            ? last_tick_us + (timer_tick - tick_count) * tick_period : now;
+        if(timer_us < next) {
+            next = timer_us;
+        }
+    }
+    uint64_t delta = (next > now) ? next - now : 0;
+    if(delta < (uint64_t)TICK_NOHZ_MIN_TICKS * tick_period) {
+        return;
+    }
+    if(delta > tick_dev->max_delta_us) {
+        delta = tick_dev->max_delta_us;
+    }
+    tick_stopped = true;
+    nohz_start_us = now;
+    tick_stats.nohz_entries++;
+    tick_dev->set_next_event(delta);
+}
+
+void tick_nohz_idle_exit(void) {
+    if(!tick_stopped) {
+        return;
+    }
+    tick_stopped = false;
+    uint64_t now = sched_clock();
+    tick_stats.nohz_us += now - nohz_start_us;
+    uint64_t skipped = (now - last_tick_us) / tick_period;
+    tick_count += skipped;
+    last_tick_us += skipped * tick_period;
+    tick_dev->set_periodic(tick_hz);
+}
+
+void tick_print_stats(void) {
+    uint64_t elapsed = sched_clock() - tick_stats.start_us;
+    uint64_t per_sec = elapsed ? tick_stats.irqs * 1000000 / elapsed : 0;
+    printf("tick: %llu timer interrupts in %llu ms (%llu/s), %llu tickless idle periods, %llu ms tick stopped\n",
+        tick_stats.irqs, elapsed / 1000, per_sec, tick_stats.nohz_entries, tick_stats.nohz_us / 1000);
+}
@@ -10,6 +10,7 @@
 #include <core/multiboot.h>
 #include <core/common.h>
 #include <mm/kmm.h>
+#include <proc/workqueue.h>
 
 volatile uint64_t* gen_cap = 0;
 volatile uint64_t* gen_conf = 0;
@@ -24,10 +25,20 @@ uint32_t int_freq = 0;
 uint32_t int_per = 0;
 
 uint32_t ticks = 0;
+// console output is too slow for the IRQ; the once-a-second report is
+// printed from the system workqueue
+static work_t hpet_report_work;
+static uint32_t hpet_report_ticks = 0;
+
+static void hpet_report(void* arg) {
+    (void)arg;
+    printf("%u\n", hpet_report_ticks);
+}
 
 void hpet_handler(int_regs_t* registers) {
     if(ticks % int_freq == 0) {
-        printf("%u\n", ticks);
+        hpet_report_ticks = ticks;
+        schedule_work(&hpet_report_work);
     }
     ticks++;
 }
@@ -87,6 +98,7 @@ void init_hpet(uint32_t freq) {
         *tim_n_conf &= tim_n_disable_mask;    
     }
 
+    work_init(&hpet_report_work, hpet_report, NULL);
     isr_set_handler(32, &hpet_handler);
     int_freq = freq;
     main_cnt_freq = (uint64_t)((double)1000000000000000 / (double)clk_per);
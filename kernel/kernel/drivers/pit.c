@@ -3,29 +3,20 @@
 #include <drivers/tty.h>
 #include <core/isr.h>
 #include <drivers/pit.h>
+#include <drivers/clockevent.h>
 #include <core/common.h>
-#include <proc/scheduler.h>
 
-double pit_osc_frequency = 3579545.0 / 3.0;
 static uint32_t pit_cur_frequency = 0;
-uint64_t tick = 0;
 
 void pit_handler(int_regs_t* registers) {
-    tick++;
-    // Every SCHED_SLICE_SECONDS, preempt user and round-robin to next.
-    uint64_t slice = (uint64_t)pit_cur_frequency * (uint64_t)SCHED_SLICE_SECONDS;
-    if (slice && (registers->cs & 3) == 3 && (tick % slice) == 0) {
-        printf("PIT: scheduling tick %llu\n", tick);
-        scheduler_switch_next(registers);
-    }
+    (void)registers;
+    clockevent_handle_interrupt();
     return;
 }
 
-void pit_init(uint32_t freq) {
-    cli();
+static void pit_set_periodic(uint32_t freq) {
     pit_cur_frequency = freq;
-    isr_set_handler(32, pit_handler);
-    uint32_t divisor = (uint32_t)(pit_osc_frequency / (double)freq);
+    uint32_t divisor = PIT_HZ / freq;
     // BCD/Binary mode: 16 bit
     // Operating mode: square wave generator
     // Access mode: low byte/high byte
@@ -35,6 +26,44 @@ void pit_init(uint32_t freq) {
     uint8_t h = (uint8_t)((divisor >> 8) & 0xFF);
     outb(0x40, l);
     outb(0x40, h);
+}
+
+static void pit_set_next_event(uint64_t delta_us) {
+    uint32_t count = (uint32_t)(delta_us * PIT_HZ / 1000000);
+    if(count == 0) {
+        count = 1;
+    } else if(count > 0xFFFF) {
+        count = 0xFFFF;
+    }
+    // Operating mode: interrupt on terminal count (one IRQ when it reaches 0)
+    // Access mode: low byte/high byte
+    // Channel: 0
+    outb(0x43, 0b00110000);
+    outb(0x40, (uint8_t)(count & 0xFF));
+    outb(0x40, (uint8_t)((count >> 8) & 0xFF));
+}
+
+static void pit_shutdown(void) {
+    // mode 0 without a count: the counter waits for a count that never comes
+    outb(0x43, 0b00110000);
+}
+
+static const clock_event_device_t pit_clockevent = {
+    .name = "pit",
+    .features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT,
+    .rating = 100,
+    .min_delta_us = PIT_MIN_DELTA_US,
+    .max_delta_us = PIT_MAX_DELTA_US,
+    .set_periodic = pit_set_periodic,
+    .set_next_event = pit_set_next_event,
+    .shutdown = pit_shutdown,
+};
+
+void pit_init(uint32_t freq) {
+    cli();
+    isr_set_handler(32, pit_handler);
+    clockevent_register(&pit_clockevent);
+    tick_init(freq);
     sti();
     return;
 }
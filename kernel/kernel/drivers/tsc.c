@@ -0,0 +1,45 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <drivers/tsc.h>
+#include <core/common.h>
+
+static uint64_t khz = 0;
+static uint64_t tsc_base = 0;
+
+void tsc_init(void) {
+    uint16_t latch = (uint16_t)(TSC_PIT_HZ / (1000 / TSC_CALIBRATE_MS));
+    // gate channel 2 on, speaker output off
+    outb(0x61, (inb(0x61) & ~0x02) | 0x01);
+    // channel 2, access lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(0x43, 0b10110000);
+    outb(0x42, (uint8_t)(latch & 0xFF));
+    outb(0x42, (uint8_t)(latch >> 8));
+
+    uint64_t start = rdtsc();
+    // OUT2 (bit 5) goes high when the count reaches zero
+    while(!(inb(0x61) & 0x20));
+    uint64_t end = rdtsc();
+
+    khz = (end - start) / TSC_CALIBRATE_MS;
+    if(khz == 0) {
+        panic("tsc: calibration failed");
+    }
+    tsc_base = end;
+    printf("TSC: %llu kHz\n", khz);
+}
+
+uint64_t tsc_khz(void) {
+    return khz;
+}
+
+uint64_t tsc_cycles_to_us(uint64_t cycles) {
+    return (cycles * 1000) / khz;
+}
+
+uint64_t tsc_cycles_to_ns(uint64_t cycles) {
+    return (cycles * 1000000) / khz;
+}
+
+uint64_t tsc_us(void) {
+    return tsc_cycles_to_us(rdtsc() - tsc_base);
+}
@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <mm/image.h>
+#include <mm/kmm.h>
+#include <mm/paging.h>
+
+// Images in use, most recently added first
+static image_t* image_list = NULL;
+
+image_t* image_get(uint32_t phys, uint32_t size) {
+    for(image_t* image = image_list; image != NULL; image = image->next) {
+        if(image->phys == phys && image->size == size) {
+            image->refcount++;
+            return image;
+        }
+    }
+    image_t* image = (image_t*)kmalloc(sizeof(image_t));
+    if(image == NULL) {
+        return NULL;
+    }
+    image->phys = phys;
+    image->size = size;
+    image->refcount = 1;
+    image->pages = NULL;
+    image->nr_pages = 0;
+    image->next = image_list;
+    image_list = image;
+    return image;
+}
+
+void image_hold(image_t* image) {
+    image->refcount++;
+}
+
+void image_put(image_t* image) {
+    if(--image->refcount > 0) {
+        return;
+    }
+    image_t** link = &image_list;
+    while(*link != image) {
+        link = &(*link)->next;
+    }
+    *link = image->next;
+    while(image->pages != NULL) {
+        image_page_t* page = image->pages;
+        image->pages = page->next;
+        free_pages(PAGE_FRAME(page->frame), 1);
+        kfree(page);
+    }
+    kfree(image);
+}
+
+uint32_t image_page_lookup(const image_t* image, uint32_t vaddr) {
+    for(image_page_t* page = image->pages; page != NULL; page = page->next) {
+        if(page->vaddr == vaddr) {
+            return page->frame;
+        }
+    }
+    return 0;
+}
+
+int image_page_insert(image_t* image, uint32_t vaddr, uint32_t frame) {
+    image_page_t* page = (image_page_t*)kmalloc(sizeof(image_page_t));
+    if(page == NULL) {
+        return -1;
+    }
+    page->vaddr = vaddr;
+    page->frame = frame;
+    page->next = image->pages;
+    image->pages = page;
+    image->nr_pages++;
+    return 0;
+}
+
+void image_print_stats(void) {
+    printf("image cache (base / size / references / filled frames):\n");
+    for(image_t* image = image_list; image != NULL; image = image->next) {
+        printf("  %x / %u / %u / %u\n", image->phys, image->size, image->refcount, image->nr_pages);
+    }
+}
@@ -6,12 +6,16 @@
 #include <mm/kmm.h>
 #include <mm/vmm.h>
 #include <mm/paging.h>
+#include <core/spinlock.h>
 
 ordered_array_t kheap_header_array;
 ordered_array_t kheap_footer_array;
 heap_t kheap;
 header_t* header_ptr_array[4096];
 footer_t* footer_ptr_array[4096];
+// Serializes kmalloc/kfree; a holder preempted halfway through a split or
+// coalesce would leave the block arrays inconsistent for the next task
+static spinlock_t kheap_lock;
 
 bool kmm_prechecks(heap_t* heap, ordered_array_t* header_array, ordered_array_t* footer_array) {
     bool ret = true;
@@ -267,14 +271,20 @@ void free(heap_t* heap, void* ptr) {
 }
 
 void* kmalloc(size_t size) {
-    return alloc(&kheap, size);
+    spin_lock(&kheap_lock);
+    void* ptr = alloc(&kheap, size);
+    spin_unlock(&kheap_lock);
+    return ptr;
 }
 
 void kfree(void* ptr) {
+    spin_lock(&kheap_lock);
     free(&kheap, ptr);
+    spin_unlock(&kheap_lock);
 }
 
 void kheap_init() {
+    spin_lock_init(&kheap_lock, "kheap");
     kheap_header_array = init_ordered_array_place((void*)(&header_ptr_array), 4096);
     kheap_footer_array = init_ordered_array_place((void*)(&footer_ptr_array), 4096);
     uint32_t start = KP2V(alloc_pages(PMM_FLAGS_DEFAULT, KHEAP_PAGES));
@@ -1,3 +1,4 @@
+#include <cpuid.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -5,22 +6,45 @@
 #include <mm/paging.h>
 #include <mm/kmm.h>
 #include <mm/vmm.h>
+#include <mm/umm.h>
+#include <mm/swap.h>
 #include <drivers/tty.h>
 #include <core/multiboot.h>
 #include <core/common.h>
 #include <core/idt.h>
 #include <core/isr.h>
+#include <core/uaccess.h>
+#include <proc/proc.h>
 
 uint8_t framemap[NFRAMES];
+// Number of frames currently marked used in `framemap`
+static uint32_t frames_used = 0;
 
 page_directory_t kernel_directory_aligned;
 page_directory_t* kernel_directory;
 page_table_t kernel_page_tables[1024 - KERN_START_TBL];
+// CR4.PSE set: page directory entries may map 4 MiB pages
+static bool pse_enabled = false;
 
 void page_fault(int_regs_t* registers) {
-    printf("page fault!\n");
     uint32_t addr;
     asm volatile("mov %%cr2, %0" : "=r" (addr));
+    // user-half fault inside a process address space: may be a lazily mapped page
+    if(addr < KP2V(0) && current_proc && current_proc->page_directory != kernel_directory) {
+        if(umm_handle_fault(current_proc, addr, registers->err_code) == 0) {
+            return;
+        }
+    }
+    // kernel touching a bad user pointer inside a uaccess routine: let the
+    // routine report the failure instead of panicking
+    if((registers->cs & 0x3) == 0) {
+        uint32_t fixup = search_exception_table(registers->eip);
+        if(fixup) {
+            registers->eip = fixup;
+            return;
+        }
+    }
+    printf("page fault!\n");
     bool protection_violation = registers->err_code & PAGE_FAULT_PRESENT_A;
     bool write = registers->err_code & PAGE_FAULT_WRITE_A;
     bool user = registers->err_code & PAGE_FAULT_USER_A;
@@ -34,14 +58,21 @@ void page_fault(int_regs_t* registers) {
     printf("instruction fetch: %d\n", instruction);
     printf("eip: %x cs: %x\n", registers->eip, registers->cs);
     printf("esp: %x useresp: %x ss: %x\n", registers->esp, registers->useresp, registers->ss);
+    if((registers->cs & 0x3) == 3) {
+        // a program's own bad access ends the program, not the kernel
+        proc_exit(PROC_EXIT_FAULT);
+    }
     panic("page fault");
-} __attribute__((noreturn));
+}
 
 // set frame as used
 void set_frame(uint32_t addr) {
     uint32_t frame = PAGE_FRAME(addr);
     uint32_t index = PAGE_FRAME_BITMAP_IDX(frame);
     uint32_t offset = PAGE_FRAME_BITMAP_OFF(frame);
+    if(!(framemap[index] & (0x1 << offset))) {
+        frames_used++;
+    }
     framemap[index] |= (0x1 << offset);
 }
 
@@ -50,9 +81,16 @@ void clear_frame(uint32_t addr) {
     uint32_t frame = PAGE_FRAME(addr);
     uint32_t index = PAGE_FRAME_BITMAP_IDX(frame);
     uint32_t offset = PAGE_FRAME_BITMAP_OFF(frame);
+    if(framemap[index] & (0x1 << offset)) {
+        frames_used--;
+    }
     framemap[index] &= ~(0x1 << offset);
 }
 
+uint32_t pmm_used_frames(void) {
+    return frames_used;
+}
+
 // check if frame is set
 bool test_frame(uint32_t addr) {
     uint32_t frame = PAGE_FRAME(addr);
@@ -62,7 +100,7 @@ bool test_frame(uint32_t addr) {
 }
 
 
-uint32_t alloc_pages(pmm_flags_t flags, uint32_t count) {
+static uint32_t pmm_find_pages(pmm_flags_t flags, uint32_t count) {
     // Physical address range split:
     // - Lowmem (identity-mapped by the kernel): [0, identity_phys_end)
     // - Highmem (requires temporary mapping via kmap): [identity_phys_end, EOM]
@@ -93,6 +131,35 @@ uint32_t alloc_pages(pmm_flags_t flags, uint32_t count) {
     return NULL;
 }
 
+uint32_t alloc_pages(pmm_flags_t flags, uint32_t count) {
+    uint32_t paddr = pmm_find_pages(flags, count);
+    // out of highmem: a single user frame can be made by evicting a page to swap
+    while(!paddr && (flags & PMM_FLAGS_HIGHMEM) && count == 1 && swap_out_page() == 0) {
+        paddr = pmm_find_pages(flags, count);
+    }
+    return paddr;
+}
+
+uint32_t alloc_pages_aligned(pmm_flags_t flags, uint32_t count, uint32_t align) {
+    uint64_t base = (flags & PMM_FLAGS_HIGHMEM) ? KERN_IDENTITY_PHYS_END : 0;
+    uint64_t end = (flags & PMM_FLAGS_HIGHMEM) ? (uint64_t)EOM + 1 : KERN_IDENTITY_PHYS_END;
+    uint64_t size = (uint64_t)count * PAGE_SIZE;
+    // only aligned candidates are tried, so each failed probe skips a whole slot
+    for(base = (base + align - 1) / align * align; base + size <= end; base += align) {
+        uint32_t i = 0;
+        while(i < count && !test_frame((uint32_t)base + i * PAGE_SIZE)) {
+            i++;
+        }
+        if(i == count) {
+            for(i = 0; i < count; i++) {
+                set_frame((uint32_t)base + i * PAGE_SIZE);
+            }
+            return (uint32_t)base;
+        }
+    }
+    return 0;
+}
+
 void free_pages(uint32_t frame, uint32_t count) {
     uint32_t paddr = frame * PAGE_SIZE;
     for(uint32_t i = 0; i < count; i++) {
@@ -111,6 +178,46 @@ void flush_tlb() {
     asm volatile("mov %0, %%cr3":: "r"(cr3));
 }
 
+void invlpg(uint32_t vaddr) {
+    asm volatile("invlpg (%0)" :: "r"(vaddr) : "memory");
+}
+
+page_t* get_page(page_directory_t* dir, uint32_t vaddr) {
+    uint32_t pd_idx = PAGE_DIR_IDX(vaddr);
+    if(!dir->page_dir_entries[pd_idx].present || dir->page_dir_entries[pd_idx].page_size
+        || dir->tables[pd_idx] == NULL) {
+        return NULL;
+    }
+    return &dir->tables[pd_idx]->pages[PAGE_TBL_IDX(vaddr)];
+}
+
+bool split_huge_page(page_directory_t* dir, uint32_t pd_idx) {
+    page_dir_entry_t* entry = &dir->page_dir_entries[pd_idx];
+    if(!entry->present || !entry->page_size) {
+        return true;
+    }
+    uint32_t table_phys = alloc_pages(PMM_FLAGS_DEFAULT, 1);
+    if(!table_phys) {
+        return false;
+    }
+    page_table_t* table = (page_table_t*)KP2V(table_phys);
+    memset(table, 0, sizeof(page_table_t));
+    // the 4 MiB run was allocated frame by frame in the bitmap, so its pieces
+    // become ordinary independently freeable 4 KiB frames
+    for(uint32_t j = 0; j < 1024; j++) {
+        set_page(&table->pages[j], entry->frame + j, true, entry->rw, entry->user);
+    }
+    dir->tables[pd_idx] = table;
+    entry->page_size = 0;
+    entry->frame = PAGE_FRAME(table_phys);
+    flush_tlb();
+    return true;
+}
+
+bool paging_pse_enabled(void) {
+    return pse_enabled;
+}
+
 void reserve(uint32_t start, uint32_t length) {
     uint32_t end;
     // round start to lower page boundary
@@ -204,6 +311,14 @@ void reserve_mem_map(multiboot_info_t* mbd) {
             reserve(mmap->addr_low, mmap->len_low);
         }
     }
+    // boot modules sit in available memory; programs loaded from them map
+    // their pages for as long as the system runs
+    if(mbd->flags & MULTIBOOT_INFO_MODS) {
+        multiboot_module_t* mods = (multiboot_module_t*)(mbd->mods_addr + 0xC0000000);
+        for(uint32_t i = 0; i < mbd->mods_count; i++) {
+            reserve(mods[i].mod_start, mods[i].mod_end - mods[i].mod_start);
+        }
+    }
 }
 
 void setup_kernel_directory() {
@@ -234,6 +349,19 @@ void set_page(page_t* page, uint32_t frame, bool present, bool rw, bool user) {
     page->user = user;
 }
 
+void enable_pse(void) {
+    uint32_t eax, ebx, ecx, edx;
+    // no leaf 1 means no feature flags, PSE included
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(edx & CPUID_FEAT_EDX_PSE)) {
+        return;
+    }
+    uint32_t cr4;
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 4);
+    asm volatile("mov %0, %%cr4" :: "r"(cr4));
+    pse_enabled = true;
+}
+
 void paging_init(multiboot_info_t* mbd, uint32_t magic) {
     // Register page fault handler
     isr_set_handler(14, &page_fault);
@@ -245,6 +373,7 @@ void paging_init(multiboot_info_t* mbd, uint32_t magic) {
     kernel_directory = &kernel_directory_aligned;
     setup_kernel_directory();
     swap_dir(kernel_directory);
+    enable_pse();
     terminal_initialize();
     reserve_mem_map(mbd);
     reserve(0, PAGE_TABLE_SIZE);
@@ -0,0 +1,169 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <mm/shm.h>
+#include <mm/kmm.h>
+#include <mm/vmm.h>
+#include <mm/paging.h>
+#include <core/syscall.h>
+#include <proc/proc.h>
+
+// Object table indexed by shm id. A slot stays occupied after destroy until
+// the last attachment is dropped, so ids are never reused while mapped.
+static shm_t* shm_table[SHM_MAX];
+
+void shm_init(void) {
+    memset(shm_table, 0, sizeof(shm_table));
+}
+
+// Drops one reference; frees the frames and the slot on the last one.
+static void shm_put(shm_t* shm) {
+    if(--shm->refcount > 0) {
+        return;
+    }
+    free_pages(PAGE_FRAME(shm->phys), shm->pages);
+    shm_table[shm->id] = NULL;
+    kfree(shm);
+}
+
+int shm_create(const char* name, uint32_t size) {
+    if(name == NULL || name[0] == '\0' || size == 0 || size > SHM_REGION_END - SHM_REGION_START) {
+        return SYSCALL_EINVAL;
+    }
+    uint32_t pages = PAGE_ROUND_UP(size) / PAGE_SIZE;
+
+    int slot = -1;
+    for(int i = 0; i < SHM_MAX; i++) {
+        shm_t* shm = shm_table[i];
+        if(shm == NULL) {
+            if(slot < 0) {
+                slot = i;
+            }
+            continue;
+        }
+        if(!shm->destroyed && strncmp(shm->name, name, SHM_NAME_MAX) == 0) {
+            return (pages <= shm->pages) ? i : SYSCALL_EINVAL;
+        }
+    }
+    if(slot < 0) {
+        return SYSCALL_ENOMEM;
+    }
+
+    uint32_t phys = alloc_pages(PMM_FLAGS_HIGHMEM, pages);
+    if(!phys) {
+        return SYSCALL_ENOMEM;
+    }
+    shm_t* shm = (shm_t*)kmalloc(sizeof(shm_t));
+    if(shm == NULL) {
+        free_pages(PAGE_FRAME(phys), pages);
+        return SYSCALL_ENOMEM;
+    }
+    // contents start out zeroed like any other anonymous memory
+    for(uint32_t i = 0; i < pages; i++) {
+        void* tmp = kmap(phys + i * PAGE_SIZE);
+        memset(tmp, 0, PAGE_SIZE);
+        kunmap(tmp);
+    }
+
+    shm->id = (uint32_t)slot;
+    size_t len = 0;
+    while(len < SHM_NAME_MAX - 1 && name[len] != '\0') {
+        shm->name[len] = name[len];
+        len++;
+    }
+    shm->name[len] = '\0';
+    shm->phys = phys;
+    shm->pages = pages;
+    shm->refcount = 1; // held by the name until shm_destroy
+    shm->destroyed = false;
+    shm_table[slot] = shm;
+    return slot;
+}
+
+// First-fit search of the attach window for `pages` free pages in `proc`.
+static uint32_t shm_find_vaddr(proc_t* proc, uint32_t pages) {
+    uint32_t vaddr = SHM_REGION_START;
+    uint32_t len = pages * PAGE_SIZE;
+    bool moved = true;
+    while(moved) {
+        moved = false;
+        for(shm_mapping_t* m = proc->shm_maps; m != NULL; m = m->next) {
+            uint32_t m_end = m->vaddr + m->shm->pages * PAGE_SIZE;
+            if(vaddr < m_end && m->vaddr < vaddr + len) {
+                vaddr = m_end;
+                moved = true;
+            }
+        }
+        if(vaddr + len > SHM_REGION_END || vaddr + len < vaddr) {
+            return 0;
+        }
+    }
+    return vaddr;
+}
+
+uint32_t shm_attach(proc_t* proc, uint32_t id) {
+    if(proc == NULL || id >= SHM_MAX || shm_table[id] == NULL || shm_table[id]->destroyed) {
+        return 0;
+    }
+    shm_t* shm = shm_table[id];
+
+    uint32_t vaddr = shm_find_vaddr(proc, shm->pages);
+    if(vaddr == 0) {
+        return 0;
+    }
+    shm_mapping_t* mapping = (shm_mapping_t*)kmalloc(sizeof(shm_mapping_t));
+    if(mapping == NULL) {
+        return 0;
+    }
+    if(proc_map_pages(proc, vaddr, shm->phys, shm->pages, true) != 0) {
+        kfree(mapping);
+        return 0;
+    }
+    // frames belong to the object, not to this address space
+    for(uint32_t i = 0; i < shm->pages; i++) {
+        get_page(proc->page_directory, vaddr + i * PAGE_SIZE)->avail = PAGE_AVAIL_SHARED;
+    }
+
+    mapping->shm = shm;
+    mapping->vaddr = vaddr;
+    mapping->next = proc->shm_maps;
+    proc->shm_maps = mapping;
+    shm->refcount++;
+    return vaddr;
+}
+
+int shm_detach(proc_t* proc, uint32_t vaddr) {
+    if(proc == NULL) {
+        return -1;
+    }
+    shm_mapping_t** link = &proc->shm_maps;
+    while(*link != NULL && (*link)->vaddr != vaddr) {
+        link = &(*link)->next;
+    }
+    shm_mapping_t* mapping = *link;
+    if(mapping == NULL) {
+        return -1;
+    }
+
+    proc_unmap_pages(proc, mapping->vaddr, mapping->shm->pages);
+    *link = mapping->next;
+    shm_put(mapping->shm);
+    kfree(mapping);
+    return 0;
+}
+
+int shm_destroy(uint32_t id) {
+    if(id >= SHM_MAX || shm_table[id] == NULL || shm_table[id]->destroyed) {
+        return -1;
+    }
+    shm_table[id]->destroyed = true;
+    shm_put(shm_table[id]);
+    return 0;
+}
+
+void shm_detach_all(proc_t* proc) {
+    while(proc != NULL && proc->shm_maps != NULL) {
+        shm_detach(proc, proc->shm_maps->vaddr);
+    }
+}
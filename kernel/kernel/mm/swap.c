@@ -0,0 +1,200 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <mm/swap.h>
+#include <mm/kmm.h>
+#include <mm/vmm.h>
+#include <mm/paging.h>
+#include <drivers/ata.h>
+#include <proc/proc.h>
+
+extern page_directory_t* kernel_directory;
+
+static uint8_t* swap_map = NULL; // one bit per slot, set = in use
+static uint32_t swap_slots = 0;
+static uint32_t swap_used = 0;
+static uint32_t swap_next = 0;   // slot search starts here (next-fit)
+static uint32_t swap_outs = 0;
+static uint32_t swap_ins = 0;
+
+// CLOCK hand: PID of the process being scanned and user virtual address
+// within it. A PID stays a valid cursor even if that process goes away.
+static pid_t clock_pid = 0;
+static uint32_t clock_vaddr = 0;
+
+void swap_init(void) {
+    if(!ata_init()) {
+        printf("swap: no disk on primary master, swapping disabled\n");
+        return;
+    }
+    uint32_t slots = ata_sector_count() / SWAP_SECTORS_PER_SLOT;
+    if(slots > SWAP_MAX_SLOTS) {
+        slots = SWAP_MAX_SLOTS;
+    }
+    swap_map = (uint8_t*)kmalloc((slots + 7) / 8);
+    if(swap_map == NULL) {
+        printf("swap: failed to allocate slot bitmap\n");
+        return;
+    }
+    memset(swap_map, 0, (slots + 7) / 8);
+    swap_slots = slots;
+    printf("swap: %u slots (%u KiB)\n", swap_slots, swap_slots * (PAGE_SIZE / 1024));
+}
+
+bool swap_enabled(void) {
+    return swap_map != NULL;
+}
+
+static uint32_t swap_alloc_slot(void) {
+    for(uint32_t n = 0; n < swap_slots; n++) {
+        uint32_t slot = (swap_next + n) % swap_slots;
+        if(!(swap_map[slot / 8] & (1 << (slot % 8)))) {
+            swap_map[slot / 8] |= (1 << (slot % 8));
+            swap_used++;
+            swap_next = slot + 1;
+            return slot;
+        }
+    }
+    return SWAP_MAX_SLOTS;
+}
+
+void swap_free_slot(uint32_t slot) {
+    if(swap_map == NULL || slot >= swap_slots) {
+        return;
+    }
+    if(swap_map[slot / 8] & (1 << (slot % 8))) {
+        swap_map[slot / 8] &= ~(1 << (slot % 8));
+        swap_used--;
+    }
+}
+
+// Only private user pages are swapped: shared, zero-frame and kernel
+// mappings carry avail bits or lack the user bit.
+static bool swap_evictable(page_t* page) {
+    return page->present && page->user && page->avail == 0;
+}
+
+// Second-chance scan. Pages with the accessed bit set have it cleared and are
+// skipped; the first evictable page found with it clear is the victim. Three
+// wraps of the process table guarantee every candidate was seen with a
+// cleared bit at least once.
+static page_t* clock_next_victim(proc_t** victim_proc, uint32_t* victim_vaddr) {
+    int wraps = 0;
+    while(wraps < 3) {
+        proc_t* p = proc_lookup(clock_pid);
+        if(p != NULL && p->page_directory != NULL
+            && p->page_directory != kernel_directory) {
+            page_directory_t* dir = p->page_directory;
+            while(clock_vaddr < KP2V(0)) {
+                uint32_t pd_idx = PAGE_DIR_IDX(clock_vaddr);
+                if(!dir->page_dir_entries[pd_idx].present || dir->tables[pd_idx] == NULL) {
+                    clock_vaddr = PAGE_IDX_VADDR(pd_idx + 1, 0, 0);
+                    continue;
+                }
+                uint32_t vaddr = clock_vaddr;
+                page_t* page = &dir->tables[pd_idx]->pages[PAGE_TBL_IDX(vaddr)];
+                clock_vaddr += PAGE_SIZE;
+                if(!swap_evictable(page)) {
+                    continue;
+                }
+                if(page->accessed) {
+                    page->accessed = 0;
+                    // a cached translation would never set the bit again
+                    if(proc_addr_space_active(p)) {
+                        invlpg(vaddr);
+                    }
+                    continue;
+                }
+                *victim_proc = p;
+                *victim_vaddr = vaddr;
+                return page;
+            }
+        }
+        clock_vaddr = 0;
+        proc_t* next = proc_next(clock_pid);
+        if(next == NULL) {
+            next = proc_first();
+            wraps++;
+        }
+        clock_pid = next->pid;
+    }
+    return NULL;
+}
+
+int swap_out_page(void) {
+    if(swap_map == NULL || swap_used == swap_slots) {
+        return -1;
+    }
+    proc_t* proc = NULL;
+    uint32_t vaddr = 0;
+    page_t* page = clock_next_victim(&proc, &vaddr);
+    if(page == NULL) {
+        return -1;
+    }
+    uint32_t slot = swap_alloc_slot();
+    if(slot == SWAP_MAX_SLOTS) {
+        return -1;
+    }
+
+    uint32_t phys = PAGE_PADDR(page->frame);
+    void* tmp = kmap(phys);
+    int rc = ata_write(slot * SWAP_SECTORS_PER_SLOT, SWAP_SECTORS_PER_SLOT, tmp);
+    kunmap(tmp);
+    if(rc != 0) {
+        printf("swap: write of slot %u failed\n", slot);
+        swap_free_slot(slot);
+        return -1;
+    }
+
+    // keep rw/user so swap-in restores the same protection
+    page->present = 0;
+    page->accessed = 0;
+    page->dirty = 0;
+    page->frame = slot;
+    page->avail = PAGE_AVAIL_SWAP;
+    if(proc_addr_space_active(proc)) {
+        invlpg(vaddr);
+    }
+    free_pages(PAGE_FRAME(phys), 1);
+    proc->swap_pages++;
+    swap_outs++;
+    return 0;
+}
+
+int swap_in_page(proc_t* proc, uint32_t vaddr, page_t* page) {
+    uint32_t slot = page->frame;
+    // may evict another page; this one is not present so it is never chosen
+    uint32_t phys = alloc_pages(PMM_FLAGS_HIGHMEM, 1);
+    if(!phys) {
+        printf("swap: no frame to swap in %x (pid %u)\n", vaddr, proc->pid);
+        return -1;
+    }
+    void* tmp = kmap(phys);
+    int rc = ata_read(slot * SWAP_SECTORS_PER_SLOT, SWAP_SECTORS_PER_SLOT, tmp);
+    kunmap(tmp);
+    if(rc != 0) {
+        printf("swap: read of slot %u failed\n", slot);
+        free_pages(PAGE_FRAME(phys), 1);
+        return -1;
+    }
+
+    page->frame = PAGE_FRAME(phys);
+    page->avail = 0;
+    page->present = 1;
+    if(proc_addr_space_active(proc)) {
+        invlpg(vaddr);
+    }
+    swap_free_slot(slot);
+    proc->swap_pages--;
+    swap_ins++;
+    return 0;
+}
+
+void swap_print_stats(void) {
+    if(swap_map == NULL) {
+        printf("swap: disabled\n");
+        return;
+    }
+    printf("swap: %u/%u slots used, %u pages out, %u pages in\n", swap_used, swap_slots, swap_outs, swap_ins);
+}
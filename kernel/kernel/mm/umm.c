@@ -0,0 +1,271 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <mm/umm.h>
+#include <mm/paging.h>
+#include <mm/vmm.h>
+#include <core/common.h>
+#include <proc/proc.h>
+#include <mm/swap.h>
+#include <proc/scheduler.h>
+#include <proc/workqueue.h>
+#include <mm/vma.h>
+
+// Physical frame backing every read-only mapping of untouched heap memory
+static uint32_t zero_frame = 0;
+
+void umm_init(void) {
+    zero_frame = alloc_pages(PMM_FLAGS_DEFAULT, 1);
+    if(!zero_frame) {
+        panic("umm: failed to allocate zero frame");
+    }
+    memset((void*)KP2V(zero_frame), 0, PAGE_SIZE);
+}
+
+uint32_t umm_zero_frame(void) {
+    return zero_frame;
+}
+
+bool umm_addr_in_heap(const proc_t* proc, uint32_t addr) {
+    if(proc == NULL || proc->heap_start == NULL) {
+        return false;
+    }
+    // the page holding the last byte below brk is part of the heap as well
+    uint32_t heap_end = PAGE_ROUND_UP((uint32_t)proc->brk);
+    return addr >= (uint32_t)proc->heap_start && addr < heap_end;
+}
+
+// Allocates a zeroed HIGHMEM frame and maps it user/writable at `vaddr`,
+// replacing whatever mapping (e.g. the zero frame) was there.
+static int umm_map_private_zeroed(proc_t* proc, uint32_t vaddr) {
+    uint32_t phys = alloc_pages(PMM_FLAGS_HIGHMEM, 1);
+    if(!phys) {
+        printf("umm: out of frames for heap page %x (pid %u)\n", vaddr, proc->pid);
+        return -1;
+    }
+    // fresh heap memory must read as zero
+    void* tmp = kmap(phys);
+    memset(tmp, 0, PAGE_SIZE);
+    kunmap(tmp);
+
+    if(proc_map_pages(proc, vaddr, phys, 1, true) != 0) {
+        free_pages(PAGE_FRAME(phys), 1);
+        return -1;
+    }
+    get_page(proc->page_directory, vaddr)->avail = 0;
+    return 0;
+}
+
+// Backs the whole 4 MiB block around `vaddr` with one zeroed huge page if the
+// block lies entirely inside the heap and nothing in it is mapped yet.
+static int umm_map_huge(proc_t* proc, uint32_t vaddr) {
+    if(!paging_pse_enabled()) {
+        return -1;
+    }
+    uint32_t base = vaddr & ~(HUGE_PAGE_SIZE - 1);
+    if(!umm_addr_in_heap(proc, base) || !umm_addr_in_heap(proc, base + HUGE_PAGE_SIZE - 1)) {
+        return -1;
+    }
+    page_dir_entry_t* entry = &proc->page_directory->page_dir_entries[PAGE_DIR_IDX(base)];
+    if(entry->present) {
+        return -1;
+    }
+    uint32_t phys = alloc_pages_aligned(PMM_FLAGS_HIGHMEM, HUGE_PAGE_FRAMES, HUGE_PAGE_SIZE);
+    if(!phys) {
+        return -1;
+    }
+    // zeroing 4 MiB takes a while; nothing else maps into this block meanwhile
+    for(uint32_t i = 0; i < HUGE_PAGE_FRAMES; i++) {
+        void* tmp = kmap(phys + i * PAGE_SIZE);
+        memset(tmp, 0, PAGE_SIZE);
+        kunmap(tmp);
+        cond_resched();
+    }
+
+    proc->page_directory->tables[PAGE_DIR_IDX(base)] = NULL;
+    entry->rw = 1;
+    entry->user = 1;
+    entry->page_size = 1;
+    entry->frame = PAGE_FRAME(phys);
+    entry->present = 1;
+    proc->huge_pages++;
+    return 0;
+}
+
+int umm_handle_fault(proc_t* proc, uint32_t addr, uint32_t err) {
+    if(proc == NULL || proc->page_directory == NULL) {
+        return -1;
+    }
+    page_t* swapped = get_page(proc->page_directory, addr);
+    if(swapped != NULL && !swapped->present && (swapped->avail & PAGE_AVAIL_SWAP)) {
+        return swap_in_page(proc, PAGE_ROUND_DOWN(addr), swapped);
+    }
+    vm_area_t* vma = vma_find(proc->vmas, addr);
+    if(vma != NULL) {
+        return vma_handle_fault(proc, vma, addr, err);
+    }
+    if(!umm_addr_in_heap(proc, addr)) {
+        return -1;
+    }
+
+    uint32_t vaddr = PAGE_ROUND_DOWN(addr);
+    bool write = err & PAGE_FAULT_WRITE_A;
+
+    if(err & PAGE_FAULT_PRESENT_A) {
+        // the only protection fault we resolve is the first write to a zero page
+        page_t* page = get_page(proc->page_directory, vaddr);
+        if(!write || page == NULL || !(page->avail & PAGE_AVAIL_ZERO)) {
+            return -1;
+        }
+        if(umm_map_private_zeroed(proc, vaddr) != 0) {
+            return -1;
+        }
+        proc->zero_pages--;
+        proc->zero_page_cow++;
+        return 0;
+    }
+
+    if(write) {
+        if(umm_map_huge(proc, vaddr) == 0) {
+            return 0;
+        }
+        return umm_map_private_zeroed(proc, vaddr);
+    }
+
+    // read of an untouched page: share the zero frame until it is written
+    if(proc_map_pages(proc, vaddr, zero_frame, 1, false) != 0) {
+        return -1;
+    }
+    get_page(proc->page_directory, vaddr)->avail = PAGE_AVAIL_SHARED | PAGE_AVAIL_ZERO;
+    proc->zero_pages++;
+    return 0;
+}
+
+int umm_set_brk(proc_t* proc, uint32_t new_brk) {
+    if(proc == NULL || proc->heap_start == NULL) {
+        return -1;
+    }
+    if(new_brk < (uint32_t)proc->heap_start || new_brk > PROC_HEAP_LIMIT) {
+        return -1;
+    }
+
+    uint32_t old_end = PAGE_ROUND_UP((uint32_t)proc->brk);
+    uint32_t new_end = PAGE_ROUND_UP(new_brk);
+    // growing is free: pages are populated by umm_handle_fault on first touch
+    if(new_end < old_end) {
+        proc_unmap_pages(proc, new_end, (old_end - new_end) / PAGE_SIZE);
+    }
+    proc->brk = (void*)new_brk;
+    return 0;
+}
+
+// A range can be collapsed if every PTE maps a private, present user page
+// with the same protection as the first one.
+static bool umm_range_collapsible(page_table_t* table) {
+    bool rw = table->pages[0].rw;
+    for(uint32_t j = 0; j < 1024; j++) {
+        page_t page = table->pages[j];
+        if(!page.present || !page.user || page.avail != 0 || page.rw != rw) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies the 1024 pages of directory slot `pd_idx` into one aligned 4 MiB run,
+// then swaps the page table for a single huge PDE and frees the old frames.
+static int umm_collapse(proc_t* proc, uint32_t pd_idx) {
+    page_directory_t* dir = proc->page_directory;
+    page_table_t* table = dir->tables[pd_idx];
+    uint32_t huge = alloc_pages_aligned(PMM_FLAGS_HIGHMEM, HUGE_PAGE_FRAMES, HUGE_PAGE_SIZE);
+    if(!huge) {
+        return -1;
+    }
+    for(uint32_t j = 0; j < 1024; j++) {
+        void* src = kmap(PAGE_PADDR(table->pages[j].frame));
+        void* dst = kmap(huge + j * PAGE_SIZE);
+        memcpy(dst, src, PAGE_SIZE);
+        kunmap(dst);
+        kunmap(src);
+    }
+
+    bool rw = table->pages[0].rw;
+    for(uint32_t j = 0; j < 1024; j++) {
+        free_pages(table->pages[j].frame, 1);
+    }
+    dir->tables[pd_idx] = NULL;
+    free_pages(PAGE_FRAME(KV2P(table)), 1);
+
+    page_dir_entry_t* entry = &dir->page_dir_entries[pd_idx];
+    entry->rw = rw;
+    entry->user = 1;
+    entry->accessed = 0;
+    entry->page_size = 1;
+    entry->frame = PAGE_FRAME(huge);
+    if(proc_addr_space_active(proc)) {
+        flush_tlb();
+    }
+    proc->huge_pages++;
+    proc->huge_promotions++;
+    return 0;
+}
+
+// Promotion cursor: PID of the process being scanned and page directory slot
+// within it
+static pid_t promote_pid = 0;
+static uint32_t promote_pd = 0;
+
+void umm_promote_scan(uint32_t budget) {
+    if(!paging_pse_enabled()) {
+        return;
+    }
+    while(budget > 0) {
+        proc_t* p = proc_lookup(promote_pid);
+        if(p != NULL && p->heap_start != NULL && promote_pd < KERN_START_TBL) {
+            uint32_t pd_idx = promote_pd++;
+            budget--;
+            page_dir_entry_t entry = p->page_directory->page_dir_entries[pd_idx];
+            if(entry.present && !entry.page_size && p->page_directory->tables[pd_idx] != NULL
+                && umm_range_collapsible(p->page_directory->tables[pd_idx])) {
+                umm_collapse(p, pd_idx);
+                return;
+            }
+            continue;
+        }
+        promote_pd = 0;
+        p = proc_next(promote_pid);
+        promote_pid = (p != NULL) ? p->pid : proc_first()->pid;
+        budget--;
+    }
+}
+
+static work_t promote_work;
+
+static void umm_promote_work(void* arg) {
+    (void)arg;
+    cli();
+    umm_promote_scan(UMM_PROMOTE_BUDGET);
+    sti();
+}
+
+void umm_promote_start(void) {
+    work_init(&promote_work, umm_promote_work, NULL);
+}
+
+void umm_promote_kick(void) {
+    // a pass still queued from the previous kick covers this one
+    schedule_work(&promote_work);
+}
+
+void umm_print_stats(void) {
+    printf("umm stats (frames saved / zero pages written / 4 MiB pages, promoted / image pages shared, copied):\n");
+    for(proc_t* p = proc_first(); p != NULL; p = proc_next(p->pid)) {
+        if(p->heap_start == NULL) {
+            continue;
+        }
+        printf("  pid %u: %u / %u / %u (%u MiB), %u / %u, %u\n", p->pid, p->zero_pages, p->zero_page_cow,
+            p->huge_pages, p->huge_pages * (HUGE_PAGE_SIZE / 0x100000), p->huge_promotions,
+            p->image_pages, p->image_copies);
+    }
+}
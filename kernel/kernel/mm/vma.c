@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <mm/vma.h>
+#include <mm/kmm.h>
+#include <mm/vmm.h>
+#include <mm/umm.h>
+#include <mm/paging.h>
+#include <proc/proc.h>
+
+vm_area_t* vma_create(image_t* image, uint32_t start, uint32_t end, uint32_t flags, uint32_t file_start,
+    uint32_t file_end, uint32_t file_offset) {
+    vm_area_t* vma = (vm_area_t*)kmalloc(sizeof(vm_area_t));
+    if(vma == NULL) {
+        return NULL;
+    }
+    vma->start = PAGE_ROUND_DOWN(start);
+    vma->end = PAGE_ROUND_UP(end);
+    vma->flags = flags;
+    vma->file_start = file_start;
+    vma->file_end = file_end;
+    vma->file_phys = image->phys + file_offset;
+    vma->image = image;
+    vma->next = NULL;
+    image_hold(image);
+    return vma;
+}
+
+int vma_insert(vm_area_t** list, vm_area_t* vma) {
+    vm_area_t** link = list;
+    while(*link != NULL && (*link)->end <= vma->start) {
+        link = &(*link)->next;
+    }
+    if(*link != NULL && (*link)->start < vma->end) {
+        return -1;
+    }
+    vma->next = *link;
+    *link = vma;
+    return 0;
+}
+
+vm_area_t* vma_find(vm_area_t* list, uint32_t addr) {
+    for(vm_area_t* vma = list; vma != NULL && vma->start <= addr; vma = vma->next) {
+        if(addr < vma->end) {
+            return vma;
+        }
+    }
+    return NULL;
+}
+
+void vma_free_list(vm_area_t** list) {
+    while(*list != NULL) {
+        vm_area_t* vma = *list;
+        *list = vma->next;
+        image_put(vma->image);
+        kfree(vma);
+    }
+}
+
+// Copies `len` image bytes at PHYSICAL address `src` to `dst`, one image page
+// at a time (the image need not be in lowmem).
+static void vma_copy_from_image(uint8_t* dst, uint32_t src, uint32_t len) {
+    while(len > 0) {
+        uint32_t chunk = PAGE_SIZE - (src & (PAGE_SIZE - 1));
+        if(chunk > len) {
+            chunk = len;
+        }
+        uint8_t* tmp = (uint8_t*)kmap(PAGE_ROUND_DOWN(src));
+        memcpy(dst, tmp + (src & (PAGE_SIZE - 1)), chunk);
+        kunmap(tmp);
+        dst += chunk;
+        src += chunk;
+        len -= chunk;
+    }
+}
+
+// Allocates a frame holding the bytes of page `vaddr` of `vma` (zero past the
+// file-backed part). Returns its PHYSICAL address, or 0 if out of frames.
+static uint32_t vma_fill_page(proc_t* proc, vm_area_t* vma, uint32_t vaddr) {
+    uint32_t phys = alloc_pages(PMM_FLAGS_HIGHMEM, 1);
+    if(!phys) {
+        printf("vma: out of frames for page %x (pid %u)\n", vaddr, proc->pid);
+        return 0;
+    }
+    uint8_t* tmp = (uint8_t*)kmap(phys);
+    memset(tmp, 0, PAGE_SIZE);
+    uint32_t lo = vaddr > vma->file_start ? vaddr : vma->file_start;
+    uint32_t hi = vaddr + PAGE_SIZE < vma->file_end ? vaddr + PAGE_SIZE : vma->file_end;
+    if(lo < hi) {
+        vma_copy_from_image(tmp + (lo - vaddr), vma->file_phys + (lo - vma->file_start), hi - lo);
+    }
+    kunmap(tmp);
+    return phys;
+}
+
+// Gives page `vaddr` of `vma` a private frame holding its image bytes,
+// replacing any shared mapping.
+static int vma_map_private(proc_t* proc, vm_area_t* vma, uint32_t vaddr) {
+    uint32_t phys = vma_fill_page(proc, vma, vaddr);
+    if(!phys) {
+        return -1;
+    }
+    if(vaddr < vma->file_end && vaddr + PAGE_SIZE > vma->file_start) {
+        proc->image_copies++;
+    }
+
+    if(proc_map_pages(proc, vaddr, phys, 1, vma->flags & VMA_WRITE) != 0) {
+        free_pages(PAGE_FRAME(phys), 1);
+        return -1;
+    }
+    get_page(proc->page_directory, vaddr)->avail = 0;
+    return 0;
+}
+
+// Maps `frame` read-only and shared at `vaddr`, tagged with `avail`.
+static int vma_map_shared(proc_t* proc, uint32_t vaddr, uint32_t frame, uint8_t avail) {
+    if(proc_map_pages(proc, vaddr, frame, 1, false) != 0) {
+        return -1;
+    }
+    get_page(proc->page_directory, vaddr)->avail = avail;
+    return 0;
+}
+
+int vma_handle_fault(proc_t* proc, vm_area_t* vma, uint32_t addr, uint32_t err) {
+    uint32_t vaddr = PAGE_ROUND_DOWN(addr);
+    bool write = err & PAGE_FAULT_WRITE_A;
+    if(write && !(vma->flags & VMA_WRITE)) {
+        return -1;
+    }
+
+    if(err & PAGE_FAULT_PRESENT_A) {
+        // the only protection fault we resolve is the first write to a shared
+        // image or zero page of a writable area
+        page_t* page = get_page(proc->page_directory, vaddr);
+        if(!write || page == NULL || !(page->avail & PAGE_AVAIL_SHARED)) {
+            return -1;
+        }
+        bool zero = page->avail & PAGE_AVAIL_ZERO;
+        if(vma_map_private(proc, vma, vaddr) != 0) {
+            return -1;
+        }
+        if(zero) {
+            proc->zero_pages--;
+            proc->zero_page_cow++;
+        } else {
+            proc->image_pages--;
+        }
+        return 0;
+    }
+
+    if(!write) {
+        if(vaddr >= vma->file_end || vaddr + PAGE_SIZE <= vma->file_start) {
+            // .bss: share the zero frame until written
+            if(vma_map_shared(proc, vaddr, umm_zero_frame(), PAGE_AVAIL_SHARED | PAGE_AVAIL_ZERO) != 0) {
+                return -1;
+            }
+            proc->zero_pages++;
+            return 0;
+        }
+        uint32_t src = vma->file_phys + (vaddr - vma->file_start);
+        if(vaddr >= vma->file_start && vaddr + PAGE_SIZE <= vma->file_end && (src & (PAGE_SIZE - 1)) == 0) {
+            if(vma_map_shared(proc, vaddr, src, PAGE_AVAIL_SHARED) != 0) {
+                return -1;
+            }
+            proc->image_pages++;
+            return 0;
+        }
+        if(!(vma->flags & VMA_WRITE)) {
+            // read-only page that needs filling: do it once for every process
+            // started from the image
+            src = image_page_lookup(vma->image, vaddr);
+            if(!src) {
+                src = vma_fill_page(proc, vma, vaddr);
+                if(!src) {
+                    return -1;
+                }
+                if(image_page_insert(vma->image, vaddr, src) != 0) {
+                    free_pages(PAGE_FRAME(src), 1);
+                    return -1;
+                }
+            }
+            if(vma_map_shared(proc, vaddr, src, PAGE_AVAIL_SHARED) != 0) {
+                return -1;
+            }
+            proc->image_pages++;
+            return 0;
+        }
+    }
+    return vma_map_private(proc, vma, vaddr);
+}
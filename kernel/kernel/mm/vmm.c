@@ -36,5 +36,7 @@ void kunmap(void* vaddr) {
         uint32_t table = PAGE_DIR_IDX((uint32_t)vaddr);
         uint32_t page = PAGE_TBL_IDX((uint32_t)vaddr);
         *(uint32_t*)(&(dir->tables[table]->pages[page])) = 0;
+        // slot is reused by the next kmap; drop any stale translation
+        invlpg((uint32_t)vaddr);
     }
 }
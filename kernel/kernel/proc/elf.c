@@ -0,0 +1,116 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <proc/elf.h>
+#include <proc/proc.h>
+#include <mm/vma.h>
+#include <mm/image.h>
+#include <mm/paging.h>
+
+// Checks the ELF header of the `size`-byte image at `ehdr`.
+static bool elf_check_header(const elf32_ehdr_t* ehdr, uint32_t size) {
+    if (size < sizeof(elf32_ehdr_t)) {
+        return false;
+    }
+    if (ehdr->e_ident[0] != ELF_MAG0 || ehdr->e_ident[1] != ELF_MAG1 ||
+        ehdr->e_ident[2] != ELF_MAG2 || ehdr->e_ident[3] != ELF_MAG3) {
+        return false;
+    }
+    if (ehdr->e_ident[4] != ELF_CLASS32 || ehdr->e_ident[5] != ELF_DATA2LSB) {
+        return false;
+    }
+    if (ehdr->e_type != ELF_ET_EXEC || ehdr->e_machine != ELF_EM_386 || ehdr->e_version != ELF_EV_CURRENT) {
+        return false;
+    }
+    if (ehdr->e_phentsize != sizeof(elf32_phdr_t) || ehdr->e_phnum == 0) {
+        return false;
+    }
+    uint64_t ph_end = (uint64_t)ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(elf32_phdr_t);
+    return ph_end <= size;
+}
+
+// Turns every PT_LOAD segment of the image into an area on `*vmas` and
+// returns the end of the highest one in `*image_end`. Returns -1 for a bad or
+// overlapping segment or when out of memory, leaving `*vmas` for the caller to
+// free.
+static int elf_build_areas(image_t* img, const elf32_ehdr_t* ehdr, uint32_t size, vm_area_t** vmas,
+    uint32_t* image_end) {
+    const elf32_phdr_t* phdrs = (const elf32_phdr_t*)((const uint8_t*)ehdr + ehdr->e_phoff);
+    for (uint32_t i = 0; i < ehdr->e_phnum; i++) {
+        const elf32_phdr_t* ph = &phdrs[i];
+        if (ph->p_type != ELF_PT_LOAD || ph->p_memsz == 0) {
+            continue;
+        }
+        uint64_t mem_end = (uint64_t)ph->p_vaddr + ph->p_memsz;
+        if (ph->p_filesz > ph->p_memsz || (uint64_t)ph->p_offset + ph->p_filesz > size ||
+            ph->p_vaddr < PAGE_SIZE || mem_end > PROC_HEAP_LIMIT) {
+            printf("elf_load: bad segment %u\n", i);
+            return -1;
+        }
+        uint32_t flags = 0;
+        if (ph->p_flags & ELF_PF_R) flags |= VMA_READ;
+        if (ph->p_flags & ELF_PF_W) flags |= VMA_WRITE;
+        if (ph->p_flags & ELF_PF_X) flags |= VMA_EXEC;
+        vm_area_t* vma = vma_create(img, ph->p_vaddr, (uint32_t)mem_end, flags,
+            ph->p_vaddr, ph->p_vaddr + ph->p_filesz, ph->p_offset);
+        if (!vma) {
+            printf("elf_load: out of memory\n");
+            return -1;
+        }
+        if (vma_insert(vmas, vma) != 0) {
+            printf("elf_load: segment %u overlaps another one\n", i);
+            vma_free_list(&vma);
+            return -1;
+        }
+        if (vma->end > *image_end) {
+            *image_end = vma->end;
+        }
+    }
+    return 0;
+}
+
+proc_t* elf_load(uint32_t image, uint32_t size, procpriority_t priority) {
+    if (image + size > KERN_IDENTITY_PHYS_END || image + size < image) {
+        printf("elf_load: image not in lowmem\n");
+        return NULL;
+    }
+    const elf32_ehdr_t* ehdr = (const elf32_ehdr_t*)KP2V(image);
+    if (!elf_check_header(ehdr, size)) {
+        printf("elf_load: not a static ELF32 i386 executable\n");
+        return NULL;
+    }
+    // instances of the same module share its cached read-only pages
+    image_t* img = image_get(image, size);
+    if (!img) {
+        printf("elf_load: out of memory\n");
+        return NULL;
+    }
+
+    // Build the areas first: once create_proc succeeds nothing may fail any
+    // more
+    vm_area_t* vmas = NULL;
+    uint32_t image_end = 0;
+    int rc = elf_build_areas(img, ehdr, size, &vmas, &image_end);
+    // the areas hold their own references
+    image_put(img);
+    if (rc != 0) {
+        vma_free_list(&vmas);
+        return NULL;
+    }
+    if (!vmas || !vma_find(vmas, ehdr->e_entry)) {
+        printf("elf_load: entry point %x outside the loaded segments\n", ehdr->e_entry);
+        vma_free_list(&vmas);
+        return NULL;
+    }
+
+    // create_proc places the heap just past [entry, entry + exec_size)
+    proc_t* proc = create_proc((void*)ehdr->e_entry, image_end - ehdr->e_entry, ELF_STACK_SIZE, 0, priority);
+    if (!proc) {
+        vma_free_list(&vmas);
+        return NULL;
+    }
+    // the first fault must already find the areas
+    proc->vmas = vmas;
+    proc_start(proc);
+    return proc;
+}
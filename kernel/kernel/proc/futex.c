@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <proc/futex.h>
+#include <proc/proc.h>
+#include <proc/scheduler.h>
+#include <core/syscall.h>
+#include <core/uaccess.h>
+#include <core/timer.h>
+#include <drivers/clockevent.h>
+#include <mm/paging.h>
+#include <mm/shm.h>
+
+// Identifies a futex word: `space` is the page directory of the owning
+// address space for a private word, 0 for a shm word whose `addr` is then
+// physical
+struct futex_key {
+    uint32_t space;
+    uint32_t addr;
+};
+
+typedef struct futex_key futex_key_t;
+
+struct futex_waiter {
+    futex_key_t key;
+    proc_t* proc;
+    // Set by the waker that unlinked the entry
+    bool woken;
+    struct futex_waiter* next;
+};
+
+typedef struct futex_waiter futex_waiter_t;
+
+struct futex_bucket {
+    futex_waiter_t* head;
+    futex_waiter_t* tail;
+};
+
+typedef struct futex_bucket futex_bucket_t;
+
+static futex_bucket_t futex_table[FUTEX_HASH_SIZE];
+
+static futex_bucket_t* futex_bucket(const futex_key_t* key) {
+    // multiplicative hashing; the low two bits of an address are always zero
+    uint32_t h = (key->addr >> 2) ^ key->space;
+    return &futex_table[(h * 0x9E3779B1u) >> (32 - FUTEX_HASH_BITS)];
+}
+
+static bool futex_key_equal(const futex_key_t* a, const futex_key_t* b) {
+    return a->space == b->space && a->addr == b->addr;
+}
+
+// Reads the word at `uaddr` into `*val` (faulting its page in) and computes
+// its key.
+static int32_t futex_get_key(uint32_t uaddr, uint32_t* val, futex_key_t* key) {
+    if (!current_proc || current_proc->kthread) {
+        return SYSCALL_EINVAL;
+    }
+    if ((uaddr & 3) != 0) {
+        return SYSCALL_EINVAL;
+    }
+    if (copy_from_user(val, (const void*)uaddr, sizeof(*val)) != 0) {
+        return SYSCALL_EFAULT;
+    }
+    // shm frames are pinned and contiguous: the same key in every process
+    // attaching the object, whatever the attach address
+    for (shm_mapping_t* m = current_proc->shm_maps; m; m = m->next) {
+        if (uaddr >= m->vaddr && uaddr - m->vaddr < m->shm->pages * PAGE_SIZE) {
+            key->space = 0;
+            key->addr = m->shm->phys + (uaddr - m->vaddr);
+            return SYSCALL_SUCCESS;
+        }
+    }
+    // anything else is private to the address space, and its frame may move
+    key->space = (uint32_t)current_proc->page_directory;
+    key->addr = uaddr;
+    return SYSCALL_SUCCESS;
+}
+
+static void futex_unlink(futex_bucket_t* bucket, futex_waiter_t* waiter) {
+    futex_waiter_t* prev = NULL;
+    for (futex_waiter_t* w = bucket->head; w; prev = w, w = w->next) {
+        if (w != waiter) continue;
+        if (prev) {
+            prev->next = w->next;
+        } else {
+            bucket->head = w->next;
+        }
+        if (bucket->tail == w) {
+            bucket->tail = prev;
+        }
+        w->next = NULL;
+        return;
+    }
+}
+
+static void futex_timeout_fn(void* arg) {
+    scheduler_wake((proc_t*)arg);
+}
+
+int32_t futex_wait(uint32_t uaddr, uint32_t val, uint64_t timeout_us) {
+    uint32_t cur;
+    futex_key_t key;
+    int32_t rc = futex_get_key(uaddr, &cur, &key);
+    if (rc != SYSCALL_SUCCESS) {
+        return rc;
+    }
+    if (cur != val) {
+        return SYSCALL_EAGAIN;
+    }
+
+    futex_bucket_t* bucket = futex_bucket(&key);
+    futex_waiter_t waiter = { key, current_proc, false, NULL };
+    if (bucket->tail) {
+        bucket->tail->next = &waiter;
+    } else {
+        bucket->head = &waiter;
+    }
+    bucket->tail = &waiter;
+
+    ktimer_t timer;
+    timer_setup(&timer, futex_timeout_fn, current_proc);
+    if (timeout_us) {
+        timer_add(&timer, tick_count + timer_us_to_ticks(timeout_us) + 1);
+    }
+    // other wakeups of this process (none today) just go back to sleep
+    while (!waiter.woken && (!timeout_us || timer_pending(&timer))) {
+        scheduler_block();
+    }
+    timer_del(&timer);
+    if (!waiter.woken) {
+        futex_unlink(bucket, &waiter);
+        return SYSCALL_ETIMEDOUT;
+    }
+    return SYSCALL_SUCCESS;
+}
+
+int32_t futex_wake(uint32_t uaddr, uint32_t count) {
+    uint32_t cur;
+    futex_key_t key;
+    int32_t rc = futex_get_key(uaddr, &cur, &key);
+    if (rc != SYSCALL_SUCCESS) {
+        return rc;
+    }
+
+    futex_bucket_t* bucket = futex_bucket(&key);
+    int32_t woken = 0;
+    futex_waiter_t* prev = NULL;
+    futex_waiter_t* w = bucket->head;
+    while (w && (uint32_t)woken < count) {
+        futex_waiter_t* next = w->next;
+        if (!futex_key_equal(&w->key, &key)) {
+            prev = w;
+            w = next;
+            continue;
+        }
+        if (prev) {
+            prev->next = next;
+        } else {
+            bucket->head = next;
+        }
+        if (bucket->tail == w) {
+            bucket->tail = prev;
+        }
+        w->next = NULL;
+        w->woken = true;
+        scheduler_wake(w->proc);
+        woken++;
+        w = next;
+    }
+    return woken;
+}
@@ -0,0 +1,217 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <proc/mutex.h>
+#include <proc/proc.h>
+#include <proc/scheduler.h>
+#include <core/spinlock.h>
+#include <core/common.h>
+
+// Guards every mutex's owner and waiters and the tasks' pi_held and
+// pi_blocked_on links, so that priority chains can be walked safely.
+// Registered by the first mutex_init, before any mutex can be contended.
+static spinlock_t mutex_pi_lock;
+static bool mutex_pi_lock_named = false;
+
+// A task is on a CPU exactly while its saved kernel stack pointer is 0
+static bool mutex_owner_running(const proc_t* p) {
+    return p->kesp == 0;
+}
+
+static void mutex_waiter_append(mutex_t* m, mutex_waiter_t* w) {
+    w->next = NULL;
+    if (m->tail) {
+        m->tail->next = w;
+    } else {
+        m->head = w;
+    }
+    m->tail = w;
+}
+
+// Unlinks and returns the highest priority waiter of `m`, the longest waiting
+// among equals, or NULL if there is none.
+static mutex_waiter_t* mutex_pop_top_waiter(mutex_t* m) {
+    mutex_waiter_t* top = NULL;
+    mutex_waiter_t* top_prev = NULL;
+    mutex_waiter_t* prev = NULL;
+    for (mutex_waiter_t* w = m->head; w; prev = w, w = w->next) {
+        if (!top || w->proc->priority > top->proc->priority) {
+            top = w;
+            top_prev = prev;
+        }
+    }
+    if (!top) {
+        return NULL;
+    }
+    if (top_prev) {
+        top_prev->next = top->next;
+    } else {
+        m->head = top->next;
+    }
+    if (m->tail == top) {
+        m->tail = top_prev;
+    }
+    top->next = NULL;
+    return top;
+}
+
+static void mutex_held_push(proc_t* p, mutex_t* m) {
+    m->held_next = p->pi_held;
+    p->pi_held = m;
+}
+
+static void mutex_held_remove(proc_t* p, mutex_t* m) {
+    mutex_t* prev = NULL;
+    for (mutex_t* it = p->pi_held; it; prev = it, it = it->held_next) {
+        if (it != m) continue;
+        if (prev) {
+            prev->held_next = it->held_next;
+        } else {
+            p->pi_held = it->held_next;
+        }
+        it->held_next = NULL;
+        return;
+    }
+}
+
+// Sets the priority of `p` to the highest of its own and those of the
+// waiters on the mutexes it holds.
+static void mutex_adjust_prio(proc_t* p) {
+    procpriority_t prio = p->normal_priority;
+    for (mutex_t* m = p->pi_held; m; m = m->held_next) {
+        for (mutex_waiter_t* w = m->head; w; w = w->next) {
+            if (w->proc->priority > prio) {
+                prio = w->proc->priority;
+            }
+        }
+    }
+    scheduler_set_priority(p, prio);
+}
+
+// Propagates a new waiter's priority to `owner` and the owners it is
+// waiting for in turn.
+static void mutex_boost_chain(proc_t* owner) {
+    for (uint32_t depth = 0; owner && depth < MUTEX_PI_MAX_DEPTH; depth++) {
+        procpriority_t before = owner->priority;
+        mutex_adjust_prio(owner);
+        if (owner->priority == before || !owner->pi_blocked_on) {
+            return;
+        }
+        owner = owner->pi_blocked_on->owner;
+    }
+}
+
+// Makes the current task the owner of free mutex `m`.
+static void mutex_take(mutex_t* m, bool contended, uint64_t wait_cycles) {
+    m->owner = current_proc;
+    mutex_held_push(current_proc, m);
+#if LOCK_STATS
+    lock_stats_account(&m->stats, contended, wait_cycles);
+#else
+    (void)contended;
+    (void)wait_cycles;
+#endif
+}
+
+void mutex_init(mutex_t* m, const char* name) {
+    if (!mutex_pi_lock_named) {
+        mutex_pi_lock_named = true;
+        spin_lock_init(&mutex_pi_lock, "mutex_pi");
+    }
+    m->owner = NULL;
+    m->head = NULL;
+    m->tail = NULL;
+    m->held_next = NULL;
+#if LOCK_STATS
+    lock_stats_register(&m->stats, name);
+#else
+    (void)name;
+#endif
+}
+
+void mutex_lock(mutex_t* m) {
+    proc_t* self = current_proc;
+    uint32_t flags = spin_lock_irqsave(&mutex_pi_lock);
+    if (!m->owner) {
+        mutex_take(m, false, 0);
+        spin_unlock_irqrestore(&mutex_pi_lock, flags);
+        return;
+    }
+    if (m->owner == self) {
+        printf("mutex_lock: pid %u already holds the mutex\n", self->pid);
+        spin_unlock_irqrestore(&mutex_pi_lock, flags);
+        return;
+    }
+    uint64_t start = rdtsc();
+
+    // adaptive spinning: an owner on another CPU is likely to be done soon
+    for (uint32_t spins = 0; m->owner && mutex_owner_running(m->owner) && spins < MUTEX_SPIN_MAX &&
+            !need_resched; spins++) {
+        spin_unlock_irqrestore(&mutex_pi_lock, flags);
+        asm volatile("pause" : : : "memory");
+        flags = spin_lock_irqsave(&mutex_pi_lock);
+    }
+    if (!m->owner) {
+        mutex_take(m, true, rdtsc() - start);
+        spin_unlock_irqrestore(&mutex_pi_lock, flags);
+        return;
+    }
+
+    mutex_waiter_t waiter = { self, NULL };
+    mutex_waiter_append(m, &waiter);
+    self->pi_blocked_on = m;
+    mutex_boost_chain(m->owner);
+    // mutex_unlock makes us the owner before waking us
+    while (m->owner != self) {
+        // blocked before the lock is dropped, so a wakeup cannot be lost
+        self->procstate = PROC_BLOCKED;
+        spin_unlock(&mutex_pi_lock);
+        schedule();
+        spin_lock(&mutex_pi_lock);
+    }
+#if LOCK_STATS
+    lock_stats_account(&m->stats, true, rdtsc() - start);
+#endif
+    spin_unlock_irqrestore(&mutex_pi_lock, flags);
+}
+
+bool mutex_trylock(mutex_t* m) {
+    uint32_t flags = spin_lock_irqsave(&mutex_pi_lock);
+    bool taken = m->owner == NULL;
+    if (taken) {
+        mutex_take(m, false, 0);
+    }
+    spin_unlock_irqrestore(&mutex_pi_lock, flags);
+    return taken;
+}
+
+void mutex_unlock(mutex_t* m) {
+    proc_t* self = current_proc;
+    uint32_t flags = spin_lock_irqsave(&mutex_pi_lock);
+    if (m->owner != self) {
+        printf("mutex_unlock: pid %u does not hold the mutex\n", self->pid);
+        spin_unlock_irqrestore(&mutex_pi_lock, flags);
+        return;
+    }
+    mutex_held_remove(self, m);
+    mutex_waiter_t* next = mutex_pop_top_waiter(m);
+    if (next) {
+        // handed over directly: a task running meanwhile cannot steal it
+        m->owner = next->proc;
+        mutex_held_push(next->proc, m);
+        next->proc->pi_blocked_on = NULL;
+        // the remaining waiters now boost the new owner
+        mutex_adjust_prio(next->proc);
+        scheduler_wake(next->proc);
+    } else {
+        m->owner = NULL;
+    }
+    mutex_adjust_prio(self);
+    // a woken waiter of higher priority takes over in preempt_enable
+    spin_unlock_irqrestore(&mutex_pi_lock, flags);
+}
+
+bool mutex_is_locked(const mutex_t* m) {
+    return m->owner != NULL;
+}
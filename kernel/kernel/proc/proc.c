@@ -7,36 +7,240 @@
 #include <mm/kmm.h>
 #include <string.h>
 #include <core/tss.h>
+#include <mm/swap.h>
+#include <proc/scheduler.h>
+#include <core/fpu.h>
+#include <mm/shm.h>
+#include <mm/vma.h>
+#include <proc/wait.h>
+
+// Entry stubs for new kernel threads and user processes (switch.S)
+extern void kthread_start(void);
+extern void proc_frame_return(void);
 
-uint32_t pid_ctr = 0;
 proc_t* current_proc;
-proc_t* proc_list[MAXPROC];
+uint32_t nr_procs = 0;
 extern page_directory_t* kernel_directory;
 
+// One bit per PID, set while the PID belongs to a registered process
+static uint32_t pid_map[PID_MAX / 32];
+// Next-fit start for PID allocation, so recently freed PIDs are not reused
+// straight away
+static pid_t pid_next = 0;
+
+// PID -> PCB hash, chained through `proc_t.hash_next`. Size is a power of two.
+static proc_t** proc_hash = NULL;
+static uint32_t proc_hash_size = 0;
+
+// PCB cache: released PCBs are kept on a free list and whole pages are carved
+// into PCBs when it runs dry, so spawning never goes through the kernel heap.
+static proc_t* pcb_free_list = NULL;
+
+// Exited tasks nobody will wait for, chained through `run_next`. They are
+// freed by proc_reap_dead once no longer running on their kernel stack.
+static proc_t* dead_list = NULL;
+
+static proc_t* pcb_alloc(void) {
+    if (!pcb_free_list) {
+        uint32_t page = alloc_pages(PMM_FLAGS_DEFAULT, 1);
+        if (!page) {
+            return NULL;
+        }
+        proc_t* pcbs = (proc_t*)KP2V(page);
+        for (uint32_t i = 0; i < PAGE_SIZE / sizeof(proc_t); i++) {
+            pcbs[i].hash_next = pcb_free_list;
+            pcb_free_list = &pcbs[i];
+        }
+    }
+    proc_t* proc = pcb_free_list;
+    pcb_free_list = proc->hash_next;
+    memset(proc, 0, sizeof(proc_t));
+    return proc;
+}
+
+// Makes `child` a child of `parent`.
+static void proc_child_link(proc_t* parent, proc_t* child) {
+    child->parent = parent;
+    child->sibling_prev = NULL;
+    child->sibling_next = parent->children;
+    if (parent->children) {
+        parent->children->sibling_prev = child;
+    }
+    parent->children = child;
+}
+
+// Removes `child` from its parent's child list; it has no parent afterwards.
+static void proc_child_unlink(proc_t* child) {
+    if (child->sibling_prev) {
+        child->sibling_prev->sibling_next = child->sibling_next;
+    } else {
+        child->parent->children = child->sibling_next;
+    }
+    if (child->sibling_next) {
+        child->sibling_next->sibling_prev = child->sibling_prev;
+    }
+    child->parent = NULL;
+    child->sibling_next = NULL;
+    child->sibling_prev = NULL;
+}
+
+static void pcb_release(proc_t* proc) {
+    proc->procstate = PROC_UNUSED;
+    proc->hash_next = pcb_free_list;
+    pcb_free_list = proc;
+}
+
+// Returns a free PID and marks it used, or PID_MAX if all are taken. Full
+// words of the bitmap are skipped 32 PIDs at a time.
+static pid_t pid_alloc(void) {
+    pid_t pid = pid_next;
+    for (uint32_t n = 0; n < PID_MAX; ) {
+        uint32_t word = pid_map[pid / 32];
+        if (word == 0xFFFFFFFF && (pid % 32) == 0) {
+            n += 32;
+            pid = (pid + 32) % PID_MAX;
+            continue;
+        }
+        if (!(word & (1u << (pid % 32)))) {
+            pid_map[pid / 32] |= (1u << (pid % 32));
+            pid_next = (pid + 1) % PID_MAX;
+            return pid;
+        }
+        n++;
+        pid = (pid + 1) % PID_MAX;
+    }
+    return PID_MAX;
+}
+
+static void pid_release(pid_t pid) {
+    pid_map[pid / 32] &= ~(1u << (pid % 32));
+}
+
+// Doubles the bucket array and rehashes every process. On allocation failure
+// the old table is kept; chains just get longer.
+static void proc_hash_grow(void) {
+    uint32_t size = proc_hash_size * 2;
+    proc_t** table = (proc_t**)kmalloc(size * sizeof(proc_t*));
+    if (!table) {
+        return;
+    }
+    memset(table, 0, size * sizeof(proc_t*));
+    for (uint32_t i = 0; i < proc_hash_size; i++) {
+        proc_t* p = proc_hash[i];
+        while (p) {
+            proc_t* next = p->hash_next;
+            p->hash_next = table[p->pid & (size - 1)];
+            table[p->pid & (size - 1)] = p;
+            p = next;
+        }
+    }
+    kfree(proc_hash);
+    proc_hash = table;
+    proc_hash_size = size;
+}
+
+// Gives `proc` a PID and makes it visible to proc_lookup/proc_next.
+// Returns -1 if the PID space is exhausted.
+static int proc_register(proc_t* proc) {
+    pid_t pid = pid_alloc();
+    if (pid == PID_MAX) {
+        return -1;
+    }
+    proc->pid = pid;
+    uint32_t bucket = pid & (proc_hash_size - 1);
+    proc->hash_next = proc_hash[bucket];
+    proc_hash[bucket] = proc;
+    nr_procs++;
+    if (nr_procs > proc_hash_size * PROC_HASH_LOAD) {
+        proc_hash_grow();
+    }
+    return 0;
+}
+
 void proc_init(void) {
-    for (int i = 0; i < MAXPROC; i++) {
-        proc_list[i] = NULL;
+    memset(pid_map, 0, sizeof(pid_map));
+    pid_next = 0;
+    proc_hash_size = PROC_HASH_INIT;
+    proc_hash = (proc_t**)kmalloc(proc_hash_size * sizeof(proc_t*));
+    if (!proc_hash) {
+        panic("proc_init: failed to allocate PID hash");
     }
+    memset(proc_hash, 0, proc_hash_size * sizeof(proc_t*));
+    nr_procs = 0;
     current_proc = NULL;
 }
 
+proc_t* proc_lookup(pid_t pid) {
+    for (proc_t* p = proc_hash[pid & (proc_hash_size - 1)]; p; p = p->hash_next) {
+        if (p->pid == pid) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+proc_t* proc_first(void) {
+    if (pid_map[0] & 1u) {
+        return proc_lookup(0);
+    }
+    return proc_next(0);
+}
+
+proc_t* proc_next(pid_t pid) {
+    uint32_t next = pid + 1;
+    while (next < PID_MAX) {
+        // drop bits at or below `pid` in the first word
+        uint32_t word = pid_map[next / 32] & (0xFFFFFFFF << (next % 32));
+        if (word) {
+            return proc_lookup((next & ~31u) + (uint32_t)__builtin_ctz(word));
+        }
+        next = (next & ~31u) + 32;
+    }
+    return NULL;
+}
+
+void proc_free(proc_t* proc) {
+    proc_t** link = &proc_hash[proc->pid & (proc_hash_size - 1)];
+    while (*link && *link != proc) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = proc->hash_next;
+        pid_release(proc->pid);
+        nr_procs--;
+    }
+    fpu_release(proc);
+    pcb_release(proc);
+}
+
 void kernel_proc_init(void) {
-    proc_t* kernel_proc = (proc_t*)kmalloc(sizeof(proc_t));
-    kernel_proc->pid = pid_ctr++; // PID 0
+    proc_t* kernel_proc = pcb_alloc();
+    if (!kernel_proc || proc_register(kernel_proc) != 0) { // PID 0
+        panic("kernel_proc_init: failed to allocate PCB");
+    }
     kernel_proc->procstate = PROC_RUNNING;
     kernel_proc->priority = PROC_PRIORITY_HIGH;
+    kernel_proc->normal_priority = PROC_PRIORITY_HIGH;
+    kernel_proc->dyn_priority = PROC_PRIORITY_HIGH;
+    kernel_proc->run_next = NULL;
     kernel_proc->page_directory = kernel_directory;
+    kernel_proc->cr3 = KV2P(kernel_directory);
+    kernel_proc->kthread = true;
     // Kernel stack and heap are managed differently, so these might be NULL or set to specific kernel values.
     // For now, let's leave them as is or set to 0/NULL.
     kernel_proc->brk = NULL;
     kernel_proc->heap_start = NULL;
+    kernel_proc->zero_pages = 0;
+    kernel_proc->zero_page_cow = 0;
+    kernel_proc->shm_maps = NULL;
+    kernel_proc->swap_pages = 0;
+    kernel_proc->huge_pages = 0;
+    kernel_proc->huge_promotions = 0;
     kernel_proc->stack_top = NULL; 
     kernel_proc->stack_size = 0; 
-    // Context for the kernel process is not switched to/from in the same way.
-    // It's effectively always "running" on CPU 0 initially.
-    // memset(&kernel_proc->context, 0, sizeof(proc_context_t)); 
+    // The kernel process is "running" on CPU 0 already; its kernel stack
+    // pointer is saved by switch_to the first time it is switched out.
 
-    proc_list[kernel_proc->pid] = kernel_proc;
     current_proc = kernel_proc;
 #ifdef PROC_DEBUG
     printf("Kernel process initialized with PID %d\n", kernel_proc->pid);
@@ -96,46 +300,173 @@ int proc_map_pages(proc_t* proc, uint32_t virt, uint32_t phys, uint32_t pages, b
     return 0;
 }
 
-proc_t* create_proc(void* entry, uint32_t exec_size, uint32_t stack_size, uint32_t heap_size, procpriority_t priority) {
-    proc_t* proc = NULL;
-    int proc_idx = -1;
-
-    // Find an empty slot in the process list
-    // Start from 1 because PID 0 is for the kernel
-    for (int i = 1; i < MAXPROC; i++) {
-        if (proc_list[i] == NULL || proc_list[i]->procstate == PROC_UNUSED) {
-            if (proc_list[i] != NULL && proc_list[i]->procstate == PROC_UNUSED) {
-                // If a slot was previously used and is now UNUSED, free its old resources if any
-                // For now, we assume kmalloc'd proc_t is the main resource to free if re-using.
-                // More complex cleanup (page tables etc.) would go here if re-using PROC_UNUSED slots
-                // that previously held a terminated process.
-                kfree(proc_list[i]); 
+void proc_unmap_pages(proc_t* proc, uint32_t virt, uint32_t pages) {
+    if (!proc || !proc->page_directory) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < pages; i++) {
+        uint32_t virt_addr = virt + (i * PAGE_SIZE);
+        page_dir_entry_t* entry = &proc->page_directory->page_dir_entries[PAGE_DIR_IDX(virt_addr)];
+        if (entry->present && entry->page_size) {
+            if (!split_huge_page(proc->page_directory, PAGE_DIR_IDX(virt_addr))) {
+                printf("proc_unmap_pages: failed to split huge page at %x\n", virt_addr);
+                continue;
+            }
+            proc->huge_pages--;
+        }
+        page_t* page = get_page(proc->page_directory, virt_addr);
+        if (!page) {
+            continue;
+        }
+        if (!page->present) {
+            if (page->avail & PAGE_AVAIL_SWAP) {
+                swap_free_slot(page->frame);
+                proc->swap_pages--;
+                *(uint32_t*)page = 0;
+            }
+            continue;
+        }
+
+        if (page->avail & PAGE_AVAIL_ZERO) {
+            proc->zero_pages--;
+        }
+        if (!(page->avail & PAGE_AVAIL_SHARED)) {
+            free_pages(page->frame, 1);
+        }
+        *(uint32_t*)page = 0;
+        if (proc_addr_space_active(proc)) {
+            invlpg(virt_addr);
+        }
+        // shrinking a large heap or mapping; not from the reaper, which runs
+        // inside schedule()
+        if (proc == current_proc) {
+            cond_resched();
+        }
+    }
+}
+
+// Frees everything mapped in the user half of `proc`'s address space: shared
+// memory attachments, private and huge frames, swap slots and the page tables
+// themselves. The page directory stays usable (kernel half only).
+static void proc_release_user_space(proc_t* proc) {
+    page_directory_t* dir = proc->page_directory;
+    if (!dir || dir == kernel_directory) {
+        return;
+    }
+    shm_detach_all(proc);
+    vma_free_list(&proc->vmas);
+    for (uint32_t i = 0; i < KERN_START_TBL; i++) {
+        page_dir_entry_t* entry = &dir->page_dir_entries[i];
+        if (!entry->present) continue;
+        if (entry->page_size) {
+            free_pages(entry->frame, HUGE_PAGE_FRAMES);
+        } else {
+            page_table_t* table = dir->tables[i];
+            for (uint32_t j = 0; table && j < 1024; j++) {
+                page_t* page = &table->pages[j];
+                if (page->present) {
+                    if (!(page->avail & PAGE_AVAIL_SHARED)) {
+                        free_pages(page->frame, 1);
+                    }
+                } else if (page->avail & PAGE_AVAIL_SWAP) {
+                    swap_free_slot(page->frame);
+                }
             }
-            proc = (proc_t*)kmalloc(sizeof(proc_t));
-            if (!proc) {
-                printf("create_proc: kmalloc failed for proc_t\n");
-                return NULL; // kmalloc failed
+            if (table) {
+                free_pages(PAGE_FRAME(KV2P(table)), 1);
             }
-            proc_idx = i;
-            break;
         }
+        *(uint32_t*)entry = 0;
+        dir->tables[i] = NULL;
+        if (proc == current_proc) {
+            cond_resched();
+        }
+    }
+    proc->zero_pages = 0;
+    proc->zero_page_cow = 0;
+    proc->swap_pages = 0;
+    proc->huge_pages = 0;
+    proc->image_pages = 0;
+    proc->heap_start = NULL;
+    proc->brk = NULL;
+    if (proc_addr_space_active(proc)) {
+        flush_tlb();
     }
+}
 
-    if (proc_idx == -1) {
-        printf("create_proc: Max processes reached\n");
-        return NULL; // No free slot
+// Frees `proc` entirely: user address space, page directory, kernel stack
+// and PCB. Also used to unwind a partially built process. `proc` must not be
+// the running task.
+void proc_destroy(proc_t* proc) {
+    if (proc->parent) {
+        proc_child_unlink(proc);
+    }
+    if (!proc->kthread && proc->page_directory) {
+        proc_release_user_space(proc);
+        if (proc_addr_space_active(proc)) {
+            swap_dir(kernel_directory);
+        }
+        free_pages(PAGE_FRAME(KV2P(proc->page_directory)), 2);
+        proc->page_directory = NULL;
+    }
+    if (proc->kstack_base) {
+        free_pages(PAGE_FRAME(KV2P(proc->kstack_base)), PROC_KSTACK_PAGES);
+        proc->kstack_base = NULL;
+    }
+    proc_free(proc);
+}
+
+// Queues exited `proc` for proc_reap_dead.
+static void proc_bury(proc_t* proc) {
+    proc->procstate = PROC_DESTROY;
+    proc->run_next = dead_list;
+    dead_list = proc;
+}
+
+// Builds the first trap frame of user process `proc` on its kernel stack, as
+// if it had entered the kernel at `eip` with user stack `user_esp`, topped by
+// a switch_to frame that returns into it through the common ISR exit.
+static void proc_init_user_frame(proc_t* proc, uint32_t eip, uint32_t user_esp) {
+    uint32_t frame_addr = (uint32_t)proc->kstack_top - sizeof(int_regs_t);
+    int_regs_t* frame = (int_regs_t*)frame_addr;
+    memset(frame, 0, sizeof(int_regs_t));
+    frame->ebp = user_esp;
+    frame->eip = eip;
+    frame->cs = 0x1B;        // User mode code selector (GDT index 3 | RPL=3)
+    frame->eflags = 0x202;   // IF=1, reserved bit always set
+    frame->useresp = user_esp;
+    frame->ss = 0x23;        // User mode data selector (GDT index 4 | RPL=3)
+
+    uint32_t* sp = (uint32_t*)frame_addr;
+    *--sp = (uint32_t)proc_frame_return;
+    *--sp = 0; // ebp
+    *--sp = 0; // ebx
+    *--sp = 0; // esi
+    *--sp = 0; // edi
+    proc->kesp = (uint32_t)sp;
+}
+
+proc_t* create_proc(void* entry, uint32_t exec_size, uint32_t stack_size, uint32_t heap_size, procpriority_t priority) {
+    proc_t* proc = pcb_alloc();
+    if (!proc) {
+        printf("create_proc: failed to allocate PCB\n");
+        return NULL;
     }
 
-    proc->pid = pid_ctr++; // Assign next available PID
     proc->procstate = PROC_SETUP;
     proc->priority = priority;
+    proc->normal_priority = priority;
+    proc->dyn_priority = priority;
+    proc->run_next = NULL;
 
-    proc->page_directory = (page_directory_t*)KP2V(alloc_pages(PMM_FLAGS_DEFAULT, 2));
-    if (!proc->page_directory) {
+    uint32_t dir_phys = alloc_pages(PMM_FLAGS_DEFAULT, 2);
+    if (!dir_phys) {
         printf("create_proc: alloc_pages failed for page directory\n");
-        kfree(proc);
+        pcb_release(proc);
         return NULL;
     }
+    proc->page_directory = (page_directory_t*)KP2V(dir_phys);
     memset(proc->page_directory, 0, PAGE_SIZE * 2); // Clear the allocated pages
 
     clone_page_dir(kernel_directory, proc->page_directory);
@@ -148,6 +479,24 @@ proc_t* create_proc(void* entry, uint32_t exec_size, uint32_t stack_size, uint32
     uint32_t stack_bottom_al = (stack_bottom & ~0xFFF);
     uint32_t stack_top_al = ((stack_top + 0xFFF) & ~0xFFF);
     uint32_t stack_pages = (stack_top_al - stack_bottom_al) / PAGE_SIZE;
+
+    // Heap begins at the first page past the executable image; the initial
+    // break reserves `heap_size` bytes but nothing is mapped until touched
+    uint32_t heap_start = PAGE_ROUND_UP((uint32_t)entry + exec_size);
+    if (heap_start + heap_size > PROC_HEAP_LIMIT || heap_start + heap_size > stack_bottom_al) {
+        printf("create_proc: heap does not fit below the stack\n");
+        proc_destroy(proc);
+        return NULL;
+    }
+    proc->heap_start = (void*)heap_start;
+    proc->brk = (void*)(heap_start + heap_size);
+    proc->zero_pages = 0;
+    proc->zero_page_cow = 0;
+    proc->shm_maps = NULL;
+    proc->swap_pages = 0;
+    proc->huge_pages = 0;
+    proc->huge_promotions = 0;
+
     uint32_t stack_phys = alloc_pages(PMM_FLAGS_HIGHMEM, stack_pages);
 
     proc->stack_top = (void*)stack_top;
@@ -155,91 +504,178 @@ proc_t* create_proc(void* entry, uint32_t exec_size, uint32_t stack_size, uint32
 
     if (!stack_phys) {
         printf("create_proc: failed to allocate stack pages\n");
+        proc_destroy(proc);
         return NULL;
     }
 
     if (proc_map_pages(proc, stack_bottom_al, stack_phys, stack_pages, true) != 0) {
         printf("create_proc: failed to map stack pages\n");
+        // pages mapped so far are freed with the address space
+        uint32_t mapped = 0;
+        while (mapped < stack_pages) {
+            page_t* page = get_page(proc->page_directory, stack_bottom_al + mapped * PAGE_SIZE);
+            if (!page || !page->present) break;
+            mapped++;
+        }
+        free_pages(PAGE_FRAME(stack_phys) + mapped, stack_pages - mapped);
+        proc_destroy(proc);
         return NULL;
     }
 
-    proc->context.eip = (uint32_t)entry;
-    proc->context.esp = stack_top - 16; // kernel ESP snapshot not used for user entry
-    proc->context.ebp = proc->context.esp; // set base pointer to stack pointer
-    // Initialize user-mode iret frame fields for future use
-    proc->context.useresp = stack_top - 16; // initial user-mode stack pointer
-    proc->context.cs = 0x1B; // User mode code selector (GDT index 3 | RPL=3)
-    proc->context.ss = 0x23; // User mode data selector (GDT index 4 | RPL=3)
-    proc->context.eflags = 0x202; // IF=1, reserved bit always set
-
     // Allocate a per-process kernel stack for privilege transitions
-    proc->kstack_size = 8192; // 8 KiB
-    void* kstack_base = kmalloc(proc->kstack_size);
+    // (lowmem pages rather than kmalloc: the 4 MiB kernel heap would cap the
+    // number of processes at a few hundred)
+    proc->kstack_size = PROC_KSTACK_PAGES * PAGE_SIZE;
+    uint32_t kstack_phys = alloc_pages(PMM_FLAGS_DEFAULT, PROC_KSTACK_PAGES);
+    if (!kstack_phys) {
+        printf("create_proc: failed to allocate kernel stack\n");
+        proc_destroy(proc);
+        return NULL;
+    }
+    void* kstack_base = (void*)KP2V(kstack_phys);
     proc->kstack_base = kstack_base;
     proc->kstack_top = (void*)((uint32_t)kstack_base + proc->kstack_size);
+    proc_init_user_frame(proc, (uint32_t)entry, stack_top - 16);
 
-    proc_list[proc_idx] = proc; // Add to process list
-    proc->procstate = PROC_RUNNING; // Or PROC_READY if we had a scheduler
+    if (proc_register(proc) != 0) {
+        printf("create_proc: out of PIDs\n");
+        proc_destroy(proc);
+        return NULL;
+    }
+    // linked last: the failure paths above have no parent to unlink from
+    if (current_proc) {
+        proc_child_link(current_proc, proc);
+    }
     printf("Created process with PID %u, entry point at vaddr %x\n", proc->pid, entry);
     return proc;
 }
 
-void proc_enter(proc_t* p) {
-    // Switch to process address space and set TSS.ESP0 to its kernel stack
-    current_proc = p;
-    tss_set_kernel_stack((uint32_t)p->kstack_top);
-    swap_dir(p->page_directory);
+void proc_start(proc_t* proc) {
+    proc->procstate = PROC_RUNNING;
+    scheduler_enqueue(proc);
+}
 
-    // Enable interrupts on entry
-    uint32_t eflags;
-    asm volatile("pushf; pop %0" : "=r"(eflags));
-    eflags |= 0x200; // IF
+proc_t* kthread_create(void (*fn)(void*), void* arg, procpriority_t priority) {
+    proc_t* proc = pcb_alloc();
+    if (!proc) {
+        printf("kthread_create: failed to allocate PCB\n");
+        return NULL;
+    }
+    uint32_t kstack_phys = alloc_pages(PMM_FLAGS_DEFAULT, PROC_KSTACK_PAGES);
+    if (!kstack_phys) {
+        printf("kthread_create: failed to allocate kernel stack\n");
+        pcb_release(proc);
+        return NULL;
+    }
+    if (proc_register(proc) != 0) {
+        printf("kthread_create: out of PIDs\n");
+        free_pages(PAGE_FRAME(kstack_phys), PROC_KSTACK_PAGES);
+        pcb_release(proc);
+        return NULL;
+    }
 
-    // Stash desired EFLAGS into context and transfer using assembly stub
-    p->context.eflags = eflags;
+    proc->kthread = true;
+    proc->page_directory = kernel_directory;
+    proc->cr3 = KV2P(kernel_directory);
+    proc->priority = priority;
+    proc->normal_priority = priority;
+    proc->dyn_priority = priority;
+    proc->kstack_size = PROC_KSTACK_PAGES * PAGE_SIZE;
+    proc->kstack_base = (void*)KP2V(kstack_phys);
+    proc->kstack_top = (void*)((uint32_t)proc->kstack_base + proc->kstack_size);
+
+    // Initial switch_to frame: "return" into kthread_start with the entry
+    // point and argument in the callee-saved registers it pops
+    uint32_t* sp = (uint32_t*)proc->kstack_top;
+    *--sp = (uint32_t)kthread_start;
+    *--sp = 0;             // ebp
+    *--sp = (uint32_t)fn;  // ebx
+    *--sp = (uint32_t)arg; // esi
+    *--sp = 0;             // edi
+    proc->kesp = (uint32_t)sp;
+
+    proc->procstate = PROC_RUNNING;
+    scheduler_enqueue(proc);
+    return proc;
+}
 
-    // Transfer to user mode using iret frame from saved context
-    iret_jump_user(&p->context);
+void kthread_exit(void) {
+    proc_exit(0);
 }
 
-void proc_context_from_regs(proc_context_t* dest, const int_regs_t* src) {
-    if (!dest || !src) {
-        return;
+void proc_exit(int32_t code) {
+    cli();
+    proc_t* p = current_proc;
+    if (p->pid == 0) {
+        panic("proc_exit: PID 0 cannot exit");
     }
+    scheduler_clear_deadline(p);
+    if (!p->kthread) {
+        proc_release_user_space(p);
+        // keep running on the kernel half only; the directory itself is
+        // freed with the zombie
+        swap_dir(kernel_directory);
+    }
+    fpu_release(p);
+    p->exit_code = code;
+    p->procstate = PROC_ZOMBIE;
+
+    // orphans are reclaimed on exit; zombies among them right now
+    while (p->children) {
+        proc_t* c = p->children;
+        proc_child_unlink(c);
+        if (c->procstate == PROC_ZOMBIE) {
+            proc_bury(c);
+        }
+    }
+    if (!p->parent || p->parent->pid == 0) {
+        // stays on PID 0's child list until proc_destroy
+        proc_bury(p);
+    } else {
+        wake_up_all(&p->parent->child_exit_wq);
+    }
+    schedule();
+    panic("proc_exit: exited task was scheduled again");
+    while (1);
+}
 
-    dest->edi = src->edi;
-    dest->esi = src->esi;
-    dest->ebp = src->ebp;
-    dest->esp = src->esp;
-    dest->ebx = src->ebx;
-    dest->edx = src->edx;
-    dest->ecx = src->ecx;
-    dest->eax = src->eax;
-
-    dest->eip = src->eip;
-    dest->eflags = src->eflags;
-    dest->cs = src->cs;
-    dest->useresp = src->useresp;
-    dest->ss = src->ss;
+pid_t proc_wait(pid_t pid, int32_t* status) {
+    proc_t* self = current_proc;
+    while (true) {
+        bool found = false;
+        for (proc_t* c = self->children; c; c = c->sibling_next) {
+            if (pid != PROC_WAIT_ANY && c->pid != pid) continue;
+            found = true;
+            if (c->procstate != PROC_ZOMBIE) continue;
+            pid_t child = c->pid;
+            if (status) {
+                *status = c->exit_code;
+            }
+            proc_destroy(c);
+            return child;
+        }
+        if (!found) {
+            return PROC_WAIT_ANY;
+        }
+        wait_queue_sleep(&self->child_exit_wq);
+    }
 }
 
-void proc_context_to_regs(int_regs_t* dest, const proc_context_t* src) {
-    if (!dest || !src) {
-        return;
+void proc_reap_dead(void) {
+    proc_t** link = &dead_list;
+    while (*link) {
+        proc_t* p = *link;
+        if (p == current_proc) {
+            link = &p->run_next;
+            continue;
+        }
+        *link = p->run_next;
+        proc_destroy(p);
     }
+}
 
-    dest->edi = src->edi;
-    dest->esi = src->esi;
-    dest->ebp = src->ebp;
-    dest->esp = src->esp;
-    dest->ebx = src->ebx;
-    dest->edx = src->edx;
-    dest->ecx = src->ecx;
-    dest->eax = src->eax;
-
-    dest->eip = src->eip;
-    dest->eflags = src->eflags;
-    dest->cs = src->cs;
-    dest->useresp = src->useresp;
-    dest->ss = src->ss;
+bool proc_addr_space_active(const proc_t* proc) {
+    uint32_t cr3;
+    asm volatile("mov %%cr3, %0" : "=r"(cr3));
+    return proc->cr3 == cr3;
 }
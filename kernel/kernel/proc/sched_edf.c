@@ -0,0 +1,248 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <core/rbtree.h>
+#include <proc/proc.h>
+#include <proc/scheduler.h>
+
+// Earliest-deadline-first class.
+//
+// - Each task declares (runtime, deadline, period). Every period starts a job
+//   with `dl_runtime` of budget due at period start + `dl_deadline`
+// - Queued tasks sit in a red-black tree keyed on the absolute deadline; the
+//   leftmost runs, and a newly queued task with an earlier deadline preempts
+// - Run time is charged against the budget. A job that runs dry is throttled
+//   (an overrun) and parked on `throttled` until its next period replenishes it
+// - A deadline that passes while the job still has budget is a miss: the job
+//   is postponed by one period with a fresh budget so the task keeps its share
+// - A task that blocks has finished its job; on wakeup after the period rolled
+//   over it starts a new job at the wakeup time. sched_yield ends the job
+//   early, throttling the task until its next period
+// - Admission control: the sum of runtime / period over all EDF tasks stays at
+//   or below SCHED_EDF_UTIL_MAX_PERMILLE, which keeps the jobs schedulable
+//   while deadline == period
+
+static rb_root_t edf_tree = { NULL };
+// Throttled tasks, linked through `run_next`
+static proc_t* throttled = NULL;
+// Admitted utilization, fixed point with SCHED_EDF_UTIL_SHIFT fraction bits
+static uint64_t edf_util = 0;
+
+static uint64_t edf_task_util(const proc_t* p) {
+    return (p->dl_runtime << SCHED_EDF_UTIL_SHIFT) / p->dl_period;
+}
+
+static bool edf_less(const rb_node_t* a, const rb_node_t* b) {
+    return rb_entry(a, proc_t, run_node)->dl_abs_deadline < rb_entry(b, proc_t, run_node)->dl_abs_deadline;
+}
+
+static proc_t* edf_leftmost(void) {
+    rb_node_t* node = rb_first(&edf_tree);
+    return node ? rb_entry(node, proc_t, run_node) : NULL;
+}
+
+static void edf_new_job(proc_t* p, uint64_t start) {
+    p->dl_abs_deadline = start + p->dl_deadline;
+    p->dl_budget = p->dl_runtime;
+    p->dl_next_period = start + p->dl_period;
+    p->dl_throttled = false;
+    p->dl_jobs++;
+}
+
+// The job's deadline passed with budget left: count it and push the job one
+// period out with a fresh budget.
+static void edf_miss(proc_t* p) {
+    p->dl_misses++;
+    p->dl_abs_deadline += p->dl_period;
+    p->dl_next_period += p->dl_period;
+    p->dl_budget = p->dl_runtime;
+    p->dl_jobs++;
+}
+
+static void edf_insert(proc_t* p) {
+    if (p->dl_throttled) {
+        p->run_next = throttled;
+        throttled = p;
+        return;
+    }
+    rb_insert(&edf_tree, &p->run_node, edf_less);
+    p->on_rq = true;
+}
+
+static void edf_enqueue(proc_t* p, bool wakeup) {
+    uint64_t now = sched_clock();
+    if (wakeup && now >= p->dl_next_period) {
+        edf_new_job(p, now);
+    }
+    edf_insert(p);
+}
+
+static void edf_dequeue(proc_t* p) {
+    rb_erase(&edf_tree, &p->run_node);
+    p->on_rq = false;
+}
+
+static void edf_put_prev(proc_t* p) {
+    edf_insert(p);
+}
+
+static proc_t* edf_pick_next(void) {
+    proc_t* p = edf_leftmost();
+    if (p) {
+        edf_dequeue(p);
+    }
+    return p;
+}
+
+static void edf_update_curr(proc_t* p, uint64_t delta_us) {
+    if (p->dl_throttled) {
+        return;
+    }
+    if (delta_us >= p->dl_budget) {
+        p->dl_budget = 0;
+        p->dl_throttled = true;
+        p->dl_overruns++;
+        return;
+    }
+    p->dl_budget -= delta_us;
+    if (sched_clock() > p->dl_abs_deadline) {
+        edf_miss(p);
+    }
+}
+
+static bool edf_slice_expired(proc_t* p) {
+    proc_t* left = edf_leftmost();
+    return p->dl_throttled || (left && left->dl_abs_deadline < p->dl_abs_deadline);
+}
+
+static bool edf_check_preempt(proc_t* curr, proc_t* p) {
+    return p->dl_abs_deadline < curr->dl_abs_deadline;
+}
+
+static void edf_periodic(uint64_t now) {
+    // replenish throttled tasks whose next period has started
+    proc_t** link = &throttled;
+    while (*link) {
+        proc_t* p = *link;
+        if (now < p->dl_next_period) {
+            link = &p->run_next;
+            continue;
+        }
+        *link = p->run_next;
+        p->run_next = NULL;
+        edf_new_job(p, p->dl_next_period);
+        if (p->procstate == PROC_RUNNING) {
+            scheduler_enqueue(p);
+        }
+    }
+    // queued jobs are in deadline order, so expired ones are leftmost
+    proc_t* left;
+    while ((left = edf_leftmost()) && left->dl_abs_deadline < now) {
+        edf_dequeue(left);
+        edf_miss(left);
+        edf_insert(left);
+    }
+}
+
+// Earliest replenishment of a throttled task
+static uint64_t edf_next_event(void) {
+    uint64_t next = UINT64_MAX;
+    for (proc_t* p = throttled; p; p = p->run_next) {
+        if (p->dl_next_period < next) next = p->dl_next_period;
+    }
+    return next;
+}
+
+// Yielding ends the current job: the task sleeps until its next period
+static void edf_yield(proc_t* p) {
+    p->dl_budget = 0;
+    p->dl_throttled = true;
+}
+
+const sched_class_t sched_edf_class = {
+    .name = "edf",
+    .enqueue = edf_enqueue,
+    .dequeue = edf_dequeue,
+    .put_prev = edf_put_prev,
+    .pick_next = edf_pick_next,
+    .update_curr = edf_update_curr,
+    .slice_expired = edf_slice_expired,
+    .check_preempt = edf_check_preempt,
+    .periodic = edf_periodic,
+    .next_event = edf_next_event,
+    .yield = edf_yield,
+};
+
+// Removes `p` from the throttled list if it is parked there.
+static void edf_unthrottle(proc_t* p) {
+    for (proc_t** link = &throttled; *link; link = &(*link)->run_next) {
+        if (*link == p) {
+            *link = p->run_next;
+            p->run_next = NULL;
+            break;
+        }
+    }
+    p->dl_throttled = false;
+}
+
+// Takes `p` off the run queue or the throttled list. Returns whether it was
+// waiting there, i.e. must be queued again once its parameters have changed.
+static bool edf_detach(proc_t* p) {
+    if (p->on_rq) {
+        scheduler_dequeue(p);
+        return true;
+    }
+    if (p->policy == SCHED_POLICY_EDF && p->dl_throttled) {
+        edf_unthrottle(p);
+        // the running task is never parked on the list
+        return p != current_proc;
+    }
+    return false;
+}
+
+int scheduler_set_deadline(proc_t* p, uint64_t runtime_us, uint64_t deadline_us, uint64_t period_us) {
+    if (!p || runtime_us == 0 || runtime_us > deadline_us || deadline_us > period_us) {
+        return -1;
+    }
+    uint64_t old_util = (p->policy == SCHED_POLICY_EDF) ? edf_task_util(p) : 0;
+    uint64_t new_util = (runtime_us << SCHED_EDF_UTIL_SHIFT) / period_us;
+    uint64_t max_util = ((uint64_t)SCHED_EDF_UTIL_MAX_PERMILLE << SCHED_EDF_UTIL_SHIFT) / 1000;
+    if (edf_util - old_util + new_util > max_util) {
+        return -2;
+    }
+
+    bool requeue = edf_detach(p);
+    edf_util = edf_util - old_util + new_util;
+    p->dl_runtime = runtime_us;
+    p->dl_deadline = deadline_us;
+    p->dl_period = period_us;
+    p->policy = SCHED_POLICY_EDF;
+    p->dl_jobs = 0;
+    edf_new_job(p, sched_clock());
+    if (requeue) {
+        scheduler_enqueue(p);
+    }
+    return 0;
+}
+
+void scheduler_clear_deadline(proc_t* p) {
+    if (!p || p->policy != SCHED_POLICY_EDF) {
+        return;
+    }
+    bool requeue = edf_detach(p);
+    p->dl_throttled = false;
+    edf_util -= edf_task_util(p);
+    p->policy = SCHED_POLICY_FAIR;
+    if (requeue) {
+        scheduler_enqueue(p);
+    }
+}
+
+void sched_edf_print_stats(void) {
+    printf("edf: utilization %llu/1000 admitted\n", (edf_util * 1000) >> SCHED_EDF_UTIL_SHIFT);
+    for (proc_t* p = proc_first(); p; p = proc_next(p->pid)) {
+        if (p->policy != SCHED_POLICY_EDF) continue;
+        printf("  pid %u: %llu/%llu/%llu us, %u jobs, %u missed, %u overruns\n", p->pid,
+            p->dl_runtime, p->dl_deadline, p->dl_period, p->dl_jobs, p->dl_misses, p->dl_overruns);
+    }
+}
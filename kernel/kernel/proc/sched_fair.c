@@ -0,0 +1,145 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <core/rbtree.h>
+#include <proc/proc.h>
+#include <proc/scheduler.h>
+
+// Fair-share class (CFS-style).
+//
+// - Every task accumulates virtual runtime: real run time scaled by
+//   SCHED_WEIGHT_NORMAL / weight, so a heavier task's clock runs slower
+// - Queued tasks sit in a red-black tree keyed on vruntime; the leftmost
+//   (least served) task runs next
+// - Its slice is its weight's share of the scheduling period, which is
+//   SCHED_LATENCY_US or, with many tasks, SCHED_MIN_GRANULARITY_US per task
+// - `min_vruntime` only moves forward and anchors woken and new tasks: they
+//   start at most half a period behind it, so sleeping earns no unbounded
+//   credit
+
+// Load weight per procpriority_t, matching nice 5 / 0 / -5 (ratio ~1.25 per
+// nice level)
+static const uint32_t prio_to_weight[SCHED_LEVELS] = {
+    [PROC_PRIORITY_LOW] = 335,
+    [PROC_PRIORITY_NORMAL] = SCHED_WEIGHT_NORMAL,
+    [PROC_PRIORITY_HIGH] = 3121,
+};
+
+static rb_root_t fair_tree = { NULL };
+static uint32_t fair_nr_queued = 0;
+static uint64_t fair_load = 0;      // sum of queued weights
+static uint64_t min_vruntime = 0;
+
+static uint32_t fair_weight(const proc_t* p) {
+    return prio_to_weight[p->priority];
+}
+
+uint32_t sched_fair_weight(const proc_t* p) {
+    return fair_weight(p);
+}
+
+static bool fair_less(const rb_node_t* a, const rb_node_t* b) {
+    return rb_entry(a, proc_t, run_node)->vruntime < rb_entry(b, proc_t, run_node)->vruntime;
+}
+
+static proc_t* fair_leftmost(void) {
+    rb_node_t* node = rb_first(&fair_tree);
+    return node ? rb_entry(node, proc_t, run_node) : NULL;
+}
+
+static void update_min_vruntime(const proc_t* curr) {
+    proc_t* left = fair_leftmost();
+    uint64_t v = min_vruntime;
+    if (curr && left) {
+        v = (curr->vruntime < left->vruntime) ? curr->vruntime : left->vruntime;
+    } else if (curr) {
+        v = curr->vruntime;
+    } else if (left) {
+        v = left->vruntime;
+    }
+    if (v > min_vruntime) {
+        min_vruntime = v;
+    }
+}
+
+static void fair_insert(proc_t* p) {
+    rb_insert(&fair_tree, &p->run_node, fair_less);
+    fair_nr_queued++;
+    fair_load += fair_weight(p);
+    p->on_rq = true;
+}
+
+static void fair_enqueue(proc_t* p, bool wakeup) {
+    if (wakeup) {
+        uint64_t floor = (min_vruntime > SCHED_LATENCY_US / 2) ? min_vruntime - SCHED_LATENCY_US / 2 : 0;
+        if (p->vruntime < floor) {
+            p->vruntime = floor;
+        }
+    }
+    fair_insert(p);
+}
+
+static void fair_dequeue(proc_t* p) {
+    rb_erase(&fair_tree, &p->run_node);
+    fair_nr_queued--;
+    fair_load -= fair_weight(p);
+    p->on_rq = false;
+}
+
+static void fair_put_prev(proc_t* p) {
+    // a task that just moved here from another class carries a stale vruntime
+    fair_enqueue(p, true);
+}
+
+static proc_t* fair_pick_next(void) {
+    proc_t* p = fair_leftmost();
+    if (p) {
+        fair_dequeue(p);
+    }
+    return p;
+}
+
+static void fair_update_curr(proc_t* p, uint64_t delta_us) {
+    uint32_t weight = fair_weight(p);
+    p->vruntime += (weight == SCHED_WEIGHT_NORMAL) ? delta_us : delta_us * SCHED_WEIGHT_NORMAL / weight;
+    update_min_vruntime(p);
+}
+
+// Slice of running task `p`: its weight's share of the period, counting it
+// among the runnable tasks
+static uint64_t fair_slice(const proc_t* p) {
+    uint32_t nr = fair_nr_queued + 1;
+    uint64_t period = SCHED_LATENCY_US;
+    if (nr > SCHED_LATENCY_US / SCHED_MIN_GRANULARITY_US) {
+        period = (uint64_t)nr * SCHED_MIN_GRANULARITY_US;
+    }
+    uint64_t load = fair_load + fair_weight(p);
+    return period * fair_weight(p) / load;
+}
+
+static bool fair_slice_expired(proc_t* p) {
+    return p->sum_exec_runtime - p->slice_start_runtime >= fair_slice(p);
+}
+
+static bool fair_check_preempt(proc_t* curr, proc_t* p) {
+    return p->vruntime + SCHED_WAKEUP_GRANULARITY_US < curr->vruntime;
+}
+
+// Queue behind the leftmost task: equal keys are inserted after it
+static void fair_yield(proc_t* p) {
+    proc_t* left = fair_leftmost();
+    if (left && left->vruntime > p->vruntime) {
+        p->vruntime = left->vruntime;
+    }
+}
+
+const sched_class_t sched_fair_class = {
+    .name = "fair",
+    .enqueue = fair_enqueue,
+    .dequeue = fair_dequeue,
+    .put_prev = fair_put_prev,
+    .pick_next = fair_pick_next,
+    .update_curr = fair_update_curr,
+    .slice_expired = fair_slice_expired,
+    .check_preempt = fair_check_preempt,
+    .yield = fair_yield,
+};
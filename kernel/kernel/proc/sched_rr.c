@@ -0,0 +1,119 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <proc/proc.h>
+#include <proc/scheduler.h>
+
+// Static priority round-robin class.
+//
+// - Tasks wait in one FIFO queue per priority level, linked through
+//   `proc_t.run_next`; bit N of `run_bitmap` is set while level N is
+//   non-empty, so picking is a find-highest-set plus a dequeue of the head
+// - A task switched out at the end of its slice goes to the tail of its base
+//   priority level
+// - Aging: each pick is one round; the head of a level below the top that has
+//   waited SCHED_AGING_ROUNDS rounds moves up a level
+
+static proc_t* run_head[SCHED_LEVELS];
+static proc_t* run_tail[SCHED_LEVELS];
+static uint32_t run_bitmap = 0;
+static uint32_t sched_round = 0;
+
+static proc_t* run_pop(uint32_t level) {
+    proc_t* p = run_head[level];
+    run_head[level] = p->run_next;
+    if (!run_head[level]) {
+        run_tail[level] = NULL;
+        run_bitmap &= ~(1u << level);
+    }
+    p->run_next = NULL;
+    p->on_rq = false;
+    return p;
+}
+
+static void run_push(proc_t* p) {
+    uint32_t level = (uint32_t)p->dyn_priority;
+    p->run_next = NULL;
+    p->enqueued_round = sched_round;
+    p->on_rq = true;
+    if (run_tail[level]) {
+        run_tail[level]->run_next = p;
+    } else {
+        run_head[level] = p;
+    }
+    run_tail[level] = p;
+    run_bitmap |= (1u << level);
+}
+
+static void rr_enqueue(proc_t* p, bool wakeup) {
+    (void)wakeup;
+    p->dyn_priority = p->priority;
+    run_push(p);
+}
+
+static void rr_put_prev(proc_t* p) {
+    rr_enqueue(p, false);
+}
+
+static void rr_dequeue(proc_t* p) {
+    uint32_t level = (uint32_t)p->dyn_priority;
+    proc_t* prev = NULL;
+    for (proc_t* it = run_head[level]; it; prev = it, it = it->run_next) {
+        if (it != p) continue;
+        if (prev) {
+            prev->run_next = p->run_next;
+            if (run_tail[level] == p) run_tail[level] = prev;
+            p->run_next = NULL;
+            p->on_rq = false;
+        } else {
+            run_pop(level);
+        }
+        return;
+    }
+}
+
+// Queue heads are the longest waiters of their level, so checking them is
+// enough to bound how long any process waits before being promoted.
+static void rr_age(void) {
+    for (uint32_t level = 0; level + 1 < SCHED_LEVELS; ++level) {
+        proc_t* p = run_head[level];
+        if (p && sched_round - p->enqueued_round >= SCHED_AGING_ROUNDS) {
+            run_pop(level);
+            p->dyn_priority = (procpriority_t)(level + 1);
+            run_push(p);
+        }
+    }
+}
+
+static proc_t* rr_pick_next(void) {
+    sched_round++;
+    rr_age();
+    if (!run_bitmap) {
+        return NULL;
+    }
+    uint32_t level = 31 - (uint32_t)__builtin_clz(run_bitmap);
+    return run_pop(level);
+}
+
+static void rr_update_curr(proc_t* p, uint64_t delta_us) {
+    (void)p;
+    (void)delta_us;
+}
+
+static bool rr_slice_expired(proc_t* p) {
+    return p->sum_exec_runtime - p->slice_start_runtime >= (uint64_t)SCHED_SLICE_SECONDS * 1000000;
+}
+
+static bool rr_check_preempt(proc_t* curr, proc_t* p) {
+    return p->priority > curr->priority;
+}
+
+const sched_class_t sched_rr_class = {
+    .name = "rr",
+    .enqueue = rr_enqueue,
+    .dequeue = rr_dequeue,
+    .put_prev = rr_put_prev,
+    .pick_next = rr_pick_next,
+    .update_curr = rr_update_curr,
+    .slice_expired = rr_slice_expired,
+    .check_preempt = rr_check_preempt,
+};
@@ -1,71 +1,427 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <proc/proc.h>
 #include <proc/scheduler.h>
 #include <mm/paging.h>
 #include <core/tss.h>
+#include <core/common.h>
+#include <drivers/tsc.h>
+#include <drivers/clockevent.h>
+#include <core/fpu.h>
+#include <core/softirq.h>
 
-// Simple round-robin scheduler driven by the PIT (IRQ0).
+// Scheduler core: class dispatch, run time accounting and context switching.
+// The classes themselves live in sched_edf.c, sched_rr.c and sched_fair.c.
 //
 // Design:
-// - Only preempts when the interrupt came from user mode (CPL=3)
-// - Saves current user context from `regs` into current_proc->context
-// - Picks next runnable user process from proc_list[] (skip NULL, kernel/CPL0,
-//   and non-running states)
-// - Switches CR3 (swap_dir) and TSS.ESP0 to the next process's kernel stack
-// - Overwrites the interrupt frame `regs` with next->context so that IRET
-//   returns into the selected process
+// - The PIT calls scheduler_tick, which charges run time and sets
+//   `need_resched` when the running task's slice is used up; the switch
+//   happens on IRQ exit (after EOI), from user or kernel mode alike
+// - The kernel is preemptible: only sections between preempt_disable and
+//   preempt_enable are not. Syscalls run with interrupts off, so long loops
+//   in them offer explicit reschedule points (cond_resched) that open a short
+//   interrupt window. Every reschedule request is timestamped and the delay
+//   until schedule() runs is recorded as the scheduling latency
+// - The running task is not queued; on a switch it is handed back to its
+//   class (put_prev) if still runnable
+// - PID 0 (the boot context in kmain) becomes the idle task once kmain enters
+//   scheduler_idle_loop: never queued, run when nothing else is runnable. It
+//   halts with the periodic tick stopped (tick_nohz_idle_enter); leaving it
+//   restarts the tick
+// - Every switch goes through switch_to and only swaps kernel stacks. A user
+//   process's registers stay in the trap frame on its own kernel stack
+//   (TSS.ESP0) from the interrupt or syscall that entered the kernel until
+//   it returns through the common ISR exit; new processes start with such a
+//   frame built by create_proc
+// - TSS.ESP0 and CR3 are only changed for user processes; kernel threads run
+//   on whichever address space is loaded
+// - FPU state is not switched here; fpu_switch only arms CR0.TS so that the
+//   next task's first FPU instruction swaps it in (core/fpu.h)
+// - Statistics are only accumulated on the switch path (counters and
+//   histograms, no output); sched_print_stats and SYS_SCHED_STATS read them
+
+volatile bool need_resched = false;
+volatile uint32_t preempt_count = 0;
+// rdtsc() when `need_resched` was last set
+static uint64_t resched_tsc = 0;
+// Set once kmain enters the idle loop; before that nothing is preempted
+static bool sched_running = false;
+static proc_t* idle_proc = NULL;
+// Tasks queued in any class
+static uint32_t nr_queued = 0;
+
+// Highest class first
+static const sched_class_t* const sched_classes[] = {
+    &sched_edf_class,
+    &sched_rr_class,
+    &sched_fair_class,
+};
+
+#define SCHED_NR_CLASSES (sizeof(sched_classes) / sizeof(sched_classes[0]))
+
+static sched_stats_t sched_stats;
+// rdtsc() at the start of the schedule() call that switched to the task now
+// resuming from switch_to
+static uint64_t switch_tsc = 0;
+
+static void sched_hist_add(sched_hist_t* hist, uint64_t value) {
+    uint32_t bucket = 0;
+    if (value >= 2) {
+        bucket = 63 - __builtin_clzll(value);
+        if (bucket >= SCHED_HIST_BUCKETS) bucket = SCHED_HIST_BUCKETS - 1;
+    }
+    hist->buckets[bucket]++;
+    hist->count++;
+    hist->sum += value;
+    if (value > hist->max) hist->max = value;
+}
+
+// `p` was just queued and starts waiting for the CPU.
+static void sched_wait_start(proc_t* p, bool wakeup) {
+    uint64_t now = sched_clock();
+    p->wait_start = now ? now : 1;
+    p->wait_wakeup = wakeup;
+}
+
+// `p` was picked to run at `now`: ends its wait.
+static void sched_wait_end(proc_t* p, uint64_t now) {
+    if (!p->wait_start) return;
+    uint64_t waited = now > p->wait_start ? now - p->wait_start : 0;
+    p->wait_sum += waited;
+    if (waited > p->wait_max) p->wait_max = waited;
+    if (p->wait_wakeup) {
+        sched_hist_add(&sched_stats.wakeup_latency_us, waited);
+    }
+    p->wait_start = 0;
+}
+
+// Asks for the running task to be switched out at the next opportunity.
+static void resched_curr(void) {
+    if (!need_resched) {
+        resched_tsc = rdtsc();
+        need_resched = true;
+    }
+}
+
+static const sched_class_t* sched_class_of(const proc_t* p) {
+    switch (p->policy) {
+        case SCHED_POLICY_EDF:
+            return &sched_edf_class;
+        case SCHED_POLICY_RR:
+            return &sched_rr_class;
+        default:
+            return &sched_fair_class;
+    }
+}
+
+// Position in sched_classes; lower runs first
+static uint32_t sched_class_rank(const sched_class_t* class) {
+    for (uint32_t i = 0; i < SCHED_NR_CLASSES; ++i) {
+        if (sched_classes[i] == class) return i;
+    }
+    return SCHED_NR_CLASSES;
+}
+
+uint64_t sched_clock(void) {
+    return tsc_us();
+}
+
+// Charges the time since `exec_start` to running task `p`.
+static void sched_update_curr(proc_t* p) {
+    uint64_t now = sched_clock();
+    uint64_t delta = now - p->exec_start;
+    p->exec_start = now;
+    p->sum_exec_runtime += delta;
+    sched_class_of(p)->update_curr(p, delta);
+}
+
+void scheduler_enqueue(proc_t* p) {
+    const sched_class_t* class = sched_class_of(p);
+    class->enqueue(p, true);
+    // a class may park the task instead (EDF throttling)
+    if (!p->on_rq) return;
+    nr_queued++;
+    // a queued task moved between classes keeps waiting since it was queued
+    if (!p->wait_start) {
+        sched_wait_start(p, true);
+    }
+
+    proc_t* curr = current_proc;
+    if (!curr || curr == idle_proc || curr->procstate != PROC_RUNNING) {
+        resched_curr();
+        return;
+    }
+    const sched_class_t* curr_class = sched_class_of(curr);
+    if (sched_class_rank(class) < sched_class_rank(curr_class)) {
+        resched_curr();
+    } else if (class == curr_class) {
+        sched_update_curr(curr);
+        if (class->check_preempt(curr, p)) {
+            resched_curr();
+        }
+    }
+}
+
+void scheduler_dequeue(proc_t* p) {
+    if (!p->on_rq) return;
+    sched_class_of(p)->dequeue(p);
+    nr_queued--;
+}
+
+void scheduler_set_policy(proc_t* p, sched_policy_t policy) {
+    if (policy == SCHED_POLICY_EDF) return; // needs a reservation
+    if (p->policy == SCHED_POLICY_EDF) {
+        scheduler_clear_deadline(p);
+    }
+    if (p->policy == policy) return;
+    bool running = p == current_proc && p != idle_proc;
+    if (running) {
+        // run time so far belongs to the old class
+        sched_update_curr(p);
+    }
+    bool queued = p->on_rq;
+    if (queued) scheduler_dequeue(p);
+    p->policy = policy;
+    if (queued) scheduler_enqueue(p);
+    // let the classes decide again whether it keeps the CPU
+    if (running) resched_curr();
+}
+
+void scheduler_set_priority(proc_t* p, procpriority_t priority) {
+    if (p->priority == priority) return;
+    if (p == current_proc && p != idle_proc) {
+        // run time so far is weighted with the old priority
+        sched_update_curr(p);
+    }
+    bool queued = p->on_rq;
+    if (queued) scheduler_dequeue(p);
+    p->priority = priority;
+    p->dyn_priority = priority;
+    if (queued) scheduler_enqueue(p);
+}
 
 proc_t* pick_next_proc(proc_t* cur) {
-    // Find the current index in the global proc list, then scan forward.
-    int cur_idx = -1;
-    for (int i = 0; i < MAXPROC; ++i) {
-        if (proc_list[i] == cur) { cur_idx = i; break; }
-    }
-
-    // Start scanning from the next slot; wrap around once.
-    for (int pass = 0; pass < 2; ++pass) {
-        int start = (cur_idx >= 0) ? (cur_idx + 1) : 0;
-        for (int i = start; i < MAXPROC; ++i) {
-            proc_t* p = proc_list[i];
-            if (!p) continue;
-            if (p == cur) continue;
-            if (p->procstate != PROC_RUNNING) continue;
-            // Only schedule user mode processes (CPL=3)
-            if ((p->context.cs & 0x3) != 0x3) continue;
+    if (cur && cur != idle_proc && cur->procstate == PROC_RUNNING) {
+        sched_class_of(cur)->put_prev(cur);
+        if (cur->on_rq) {
+            nr_queued++;
+            sched_wait_start(cur, false);
+        }
+    }
+    for (uint32_t i = 0; i < SCHED_NR_CLASSES; ++i) {
+        proc_t* p = sched_classes[i]->pick_next();
+        if (p) {
+            nr_queued--;
             return p;
         }
-        // wrap
-        cur_idx = -1;
     }
     return NULL;
 }
 
-void scheduler_init(void) { }
+void scheduler_tick(void) {
+    uint64_t now = sched_clock();
+    for (uint32_t i = 0; i < SCHED_NR_CLASSES; ++i) {
+        if (sched_classes[i]->periodic) sched_classes[i]->periodic(now);
+    }
+    proc_t* curr = current_proc;
+    if (!curr || curr == idle_proc) return;
+    sched_update_curr(curr);
+    if (sched_class_of(curr)->slice_expired(curr)) {
+        resched_curr();
+    }
+}
+
+bool scheduler_idle(void) {
+    return current_proc == idle_proc && nr_queued == 0;
+}
+
+uint64_t scheduler_next_event(void) {
+    uint64_t next = UINT64_MAX;
+    for (uint32_t i = 0; i < SCHED_NR_CLASSES; ++i) {
+        if (!sched_classes[i]->next_event) continue;
+        uint64_t t = sched_classes[i]->next_event();
+        if (t < next) next = t;
+    }
+    return next;
+}
 
-void scheduler_switch_process(proc_t* next, int_regs_t* regs) {
-    if (!next || next == current_proc) return;
+void scheduler_init(void) {
+    nr_queued = 0;
+    idle_proc = current_proc;
+}
 
-    proc_context_from_regs(&current_proc->context, regs);
+void schedule(void) {
+    uint64_t start_tsc = rdtsc();
+    if (need_resched) {
+        sched_hist_add(&sched_stats.resched_latency_us, tsc_cycles_to_us(start_tsc - resched_tsc));
+        need_resched = false;
+    }
+    if (preempt_count) {
+        printf("schedule: called with preemption disabled (count %u, pid %u)\n", preempt_count,
+            current_proc->pid);
+    }
+    // tasks that exited before the previous switch are off their stacks now
+    proc_reap_dead();
+    proc_t* prev = current_proc;
+    if (prev != idle_proc) {
+        sched_update_curr(prev);
+    }
 
-    tss_set_kernel_stack((uint32_t)next->kstack_top);
-    swap_dir(next->page_directory);
+    proc_t* next = pick_next_proc(prev);
+    if (!next) {
+        // a runnable prev would have been requeued and picked; it was
+        // parked instead (e.g. a throttled EDF task)
+        next = idle_proc;
+    }
+    next->exec_start = sched_clock();
+    next->slice_start_runtime = next->sum_exec_runtime;
+    if (next != idle_proc) {
+        sched_wait_end(next, next->exec_start);
+    }
+    if (next == prev) return;
+    sched_stats.nr_switches++;
+    if (prev != idle_proc) {
+        if (prev->procstate == PROC_RUNNING) {
+            prev->nivcsw++;
+        } else {
+            prev->nvcsw++;
+        }
+    }
+    if (prev == idle_proc) {
+        // woken by an interrupt other than the tick: tasks need their tick
+        tick_nohz_idle_exit();
+    }
+
+    if (!next->kthread && next != idle_proc) {
+        tss_set_kernel_stack((uint32_t)next->kstack_top);
+        if (!proc_addr_space_active(next)) {
+            swap_dir(next->page_directory);
+        }
+    }
     current_proc = next;
-    printf("Scheduler: switching to process #%u\n", current_proc->pid);
+    fpu_switch(next);
+
+    uint32_t next_kesp = next->kesp;
+    next->kesp = 0;
+    switch_tsc = start_tsc;
+    switch_to(&prev->kesp, next_kesp);
+    // resumed by some later schedule() call
+    sched_hist_add(&sched_stats.switch_cost_ns, tsc_cycles_to_ns(rdtsc() - switch_tsc));
+}
+
+void scheduler_irq_exit(void) {
+    // kmain may still be setting up the tasks it queued
+    if (!sched_running) return;
+    if (current_proc == idle_proc && nr_queued) {
+        resched_curr();
+    }
+    // an interrupted preempt_disable section switches in preempt_enable
+    if (need_resched && !preempt_count) {
+        schedule();
+    }
+}
 
-    // Put the next process's context into regs, so on iret we  next.
-    proc_context_to_regs(regs, &next->context);
+void preempt_disable(void) {
+    preempt_count++;
+    asm volatile("" : : : "memory");
 }
 
-// Immediate yield from an ISR context (e.g., explicit call or timeslice expiry).
-void scheduler_switch_next(int_regs_t* regs) {
-    // Only switch if interrupt came from user mode (CPL=3)
-    if ((regs->cs & 0x3) != 0x3) return;
+void preempt_enable(void) {
+    asm volatile("" : : : "memory");
+    if (--preempt_count || !sched_running) return;
+    // with interrupts off the caller may still rely on them for atomicity;
+    // the next IRQ exit or cond_resched takes over the pending work
+    if (!irqs_enabled()) return;
+    if (!need_resched && !softirq_pending()) return;
+    cli();
+    // softirqs skipped by an IRQ that hit this section
+    do_softirq();
+    if (need_resched) {
+        schedule();
+    }
+    sti();
+}
+
+bool cond_resched(void) {
+    if (preempt_count || !sched_running) return false;
+    uint64_t switches = sched_stats.nr_switches;
+    if (irqs_enabled()) {
+        if (need_resched) {
+            cli();
+            schedule();
+            sti();
+        }
+    } else {
+        // let a pending tick in; it may switch away right here on IRQ exit
+        asm volatile("sti; nop; cli" : : : "memory");
+        if (need_resched) {
+            schedule();
+        }
+    }
+    return sched_stats.nr_switches != switches;
+}
+
+void scheduler_block(void) {
+    current_proc->procstate = PROC_BLOCKED;
+    schedule();
+}
 
-    // Save current user context
-    proc_context_from_regs(&current_proc->context, regs);
+void scheduler_wake(proc_t* p) {
+    if (!p || p->procstate != PROC_BLOCKED) return;
+    p->procstate = PROC_RUNNING;
+    scheduler_enqueue(p);
+}
 
-    // Choose next runnable process
-    proc_t* next = pick_next_proc(current_proc);
-    scheduler_switch_process(next, regs);
+void sched_yield(void) {
+    proc_t* curr = current_proc;
+    if (curr == idle_proc) return;
+    sched_update_curr(curr);
+    const sched_class_t* class = sched_class_of(curr);
+    if (class->yield) {
+        class->yield(curr);
+    }
+    schedule();
+}
+
+void scheduler_idle_loop(void) {
+    sched_running = true;
+    while (true) {
+        cli();
+        while (!nr_queued) {
+            tick_nohz_idle_enter();
+            // sti only takes effect after the next instruction, so no wakeup
+            // is lost between it and hlt
+            asm volatile("sti; hlt");
+            cli();
+            tick_nohz_idle_exit();
+        }
+        schedule();
+        sti();
+    }
+}
+
+void sched_get_stats(sched_stats_t* out) {
+    *out = sched_stats;
+}
+
+static void sched_print_hist(const char* name, const char* unit, const sched_hist_t* hist) {
+    uint64_t avg = hist->count ? hist->sum / hist->count : 0;
+    printf("%s: %u samples, avg %llu %s, max %llu %s\n", name, hist->count, avg, unit, hist->max, unit);
+    for (uint32_t i = 0; i < SCHED_HIST_BUCKETS; i++) {
+        if (!hist->buckets[i]) continue;
+        printf("  >= %u %s: %u\n", i ? 1u << i : 0u, unit, hist->buckets[i]);
+    }
+}
+
+void sched_print_stats(void) {
+    printf("sched: %llu switches (pid: run ms / wait ms / max wait us / voluntary / involuntary)\n",
+        sched_stats.nr_switches);
+    for (proc_t* p = proc_first(); p; p = proc_next(p->pid)) {
+        printf("  pid %u: %llu / %llu / %llu / %u / %u\n", p->pid, p->sum_exec_runtime / 1000,
+            p->wait_sum / 1000, p->wait_max, p->nvcsw, p->nivcsw);
+    }
+    sched_print_hist("wakeup latency", "us", &sched_stats.wakeup_latency_us);
+    sched_print_hist("scheduling latency", "us", &sched_stats.resched_latency_us);
+    sched_print_hist("switch cost", "ns", &sched_stats.switch_cost_ns);
 }
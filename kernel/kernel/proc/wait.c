@@ -0,0 +1,97 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <proc/wait.h>
+#include <proc/scheduler.h>
+#include <core/timer.h>
+#include <drivers/clockevent.h>
+
+void wait_queue_init(wait_queue_t* wq) {
+    wq->head = NULL;
+    wq->tail = NULL;
+}
+
+bool wait_queue_empty(const wait_queue_t* wq) {
+    return wq->head == NULL;
+}
+
+static void wait_queue_append(wait_queue_t* wq, wait_queue_entry_t* entry) {
+    entry->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = entry;
+    } else {
+        wq->head = entry;
+    }
+    wq->tail = entry;
+}
+
+static wait_queue_entry_t* wait_queue_pop(wait_queue_t* wq) {
+    wait_queue_entry_t* entry = wq->head;
+    if (entry) {
+        wq->head = entry->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        entry->next = NULL;
+    }
+    return entry;
+}
+
+// Unlinks `entry` if it is still queued. Returns whether it was.
+static bool wait_queue_remove(wait_queue_t* wq, wait_queue_entry_t* entry) {
+    wait_queue_entry_t* prev = NULL;
+    for (wait_queue_entry_t* e = wq->head; e; prev = e, e = e->next) {
+        if (e != entry) continue;
+        if (prev) {
+            prev->next = e->next;
+        } else {
+            wq->head = e->next;
+        }
+        if (wq->tail == e) {
+            wq->tail = prev;
+        }
+        e->next = NULL;
+        return true;
+    }
+    return false;
+}
+
+void wait_queue_sleep(wait_queue_t* wq) {
+    wait_queue_entry_t entry = { current_proc, NULL };
+    wait_queue_append(wq, &entry);
+    scheduler_block();
+    // woken by someone else than a waker of `wq`
+    wait_queue_remove(wq, &entry);
+}
+
+static void wait_timeout_fn(void* arg) {
+    scheduler_wake((proc_t*)arg);
+}
+
+bool wait_queue_sleep_timeout(wait_queue_t* wq, uint64_t timeout_us) {
+    wait_queue_entry_t entry = { current_proc, NULL };
+    ktimer_t timer;
+    timer_setup(&timer, wait_timeout_fn, current_proc);
+    timer_add(&timer, tick_count + timer_us_to_ticks(timeout_us) + 1);
+    wait_queue_append(wq, &entry);
+    scheduler_block();
+    timer_del(&timer);
+    return !wait_queue_remove(wq, &entry);
+}
+
+bool wake_up_one(wait_queue_t* wq) {
+    wait_queue_entry_t* entry = wait_queue_pop(wq);
+    if (!entry) {
+        return false;
+    }
+    scheduler_wake(entry->proc);
+    return true;
+}
+
+uint32_t wake_up_all(wait_queue_t* wq) {
+    uint32_t woken = 0;
+    while (wake_up_one(wq)) {
+        woken++;
+    }
+    return woken;
+}
@@ -0,0 +1,124 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <proc/workqueue.h>
+#include <proc/proc.h>
+#include <proc/wait.h>
+#include <mm/kmm.h>
+#include <core/common.h>
+
+workqueue_t* system_wq = NULL;
+// Every queue created, newest first
+static workqueue_t* workqueues = NULL;
+
+static void worker_thread(void* arg) {
+    workqueue_t* wq = (workqueue_t*)arg;
+    while (true) {
+        cli();
+        wait_event(&wq->wait, wq->head != NULL);
+        work_t* work = wq->head;
+        wq->head = work->next;
+        if (!wq->head) {
+            wq->tail = NULL;
+        }
+        work->next = NULL;
+        // may be queued again from here on, even by itself
+        work->pending = false;
+        sti();
+        work->fn(work->arg);
+        wq->nr_done++;
+    }
+}
+
+workqueue_t* workqueue_create(const char* name, procpriority_t priority) {
+    workqueue_t* wq = (workqueue_t*)kmalloc(sizeof(workqueue_t));
+    if (!wq) {
+        return NULL;
+    }
+    wq->name = name;
+    wq->head = NULL;
+    wq->tail = NULL;
+    wait_queue_init(&wq->wait);
+    wq->nr_done = 0;
+    wq->worker = kthread_create(worker_thread, wq, priority);
+    if (!wq->worker) {
+        kfree(wq);
+        return NULL;
+    }
+    wq->next = workqueues;
+    workqueues = wq;
+    return wq;
+}
+
+void workqueue_init(void) {
+    system_wq = workqueue_create("events", PROC_PRIORITY_NORMAL);
+    if (!system_wq) {
+        printf("workqueue: failed to create the system workqueue\n");
+    }
+}
+
+void work_init(work_t* work, void (*fn)(void*), void* arg) {
+    work->fn = fn;
+    work->arg = arg;
+    work->next = NULL;
+    work->pending = false;
+}
+
+bool queue_work(workqueue_t* wq, work_t* work) {
+    uint32_t flags = irq_save();
+    if (work->pending) {
+        irq_restore(flags);
+        return false;
+    }
+    work->pending = true;
+    work->next = NULL;
+    if (wq->tail) {
+        wq->tail->next = work;
+    } else {
+        wq->head = work;
+    }
+    wq->tail = work;
+    wake_up_one(&wq->wait);
+    irq_restore(flags);
+    return true;
+}
+
+bool schedule_work(work_t* work) {
+    if (!system_wq) {
+        return false;
+    }
+    return queue_work(system_wq, work);
+}
+
+bool cancel_work(workqueue_t* wq, work_t* work) {
+    uint32_t flags = irq_save();
+    work_t* prev = NULL;
+    for (work_t* w = wq->head; w; prev = w, w = w->next) {
+        if (w != work) continue;
+        if (prev) {
+            prev->next = w->next;
+        } else {
+            wq->head = w->next;
+        }
+        if (wq->tail == w) {
+            wq->tail = prev;
+        }
+        w->next = NULL;
+        w->pending = false;
+        irq_restore(flags);
+        return true;
+    }
+    irq_restore(flags);
+    return false;
+}
+
+void workqueue_print_stats(void) {
+    printf("workqueues (name: worker pid / queued / done):\n");
+    for (workqueue_t* wq = workqueues; wq; wq = wq->next) {
+        uint32_t queued = 0;
+        for (work_t* w = wq->head; w; w = w->next) {
+            queued++;
+        }
+        printf("  %s: %u / %u / %llu\n", wq->name, wq->worker->pid, queued, wq->nr_done);
+    }
+}
@@ -2,13 +2,16 @@
 set -e
 . ./clean.sh
 . ./iso.sh
+# Primary master IDE disk used as the swap area
+[ -f swap.img ] || dd if=/dev/zero of=swap.img bs=1M count=64
+SWAP_DRIVE="-drive file=swap.img,format=raw,index=0,media=disk"
 if [ $1 -eq 1 ]
 then
- qemu-system-$(./target-triplet-to-arch.sh $HOST) -m 3G -smp 2 -s -S -cdrom brownieos.iso &
+ qemu-system-$(./target-triplet-to-arch.sh $HOST) -m 3G -smp 2 -s -S -cdrom brownieos.iso $SWAP_DRIVE &
  gdb -ex "target remote localhost:1234" -ex "symbol-file sysroot/boot/brownieos.kernel" -ex "layout src"
 elif [ $1 -eq 2 ]
 then
- qemu-system-$(./target-triplet-to-arch.sh $HOST) -m 3G -smp 2 -cdrom brownieos.iso -monitor stdio
+ qemu-system-$(./target-triplet-to-arch.sh $HOST) -m 3G -smp 2 -cdrom brownieos.iso $SWAP_DRIVE -monitor stdio
 else
- qemu-system-$(./target-triplet-to-arch.sh $HOST) -m 3G -smp 2 -cdrom brownieos.iso
+ qemu-system-$(./target-triplet-to-arch.sh $HOST) -m 3G -smp 2 -cdrom brownieos.iso $SWAP_DRIVE
 fi
\ No newline at end of file